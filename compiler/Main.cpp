@@ -12,19 +12,28 @@
 // You should have received a copy of the GNU General Public License along with
 // SymCC. If not, see <https://www.gnu.org/licenses/>.
 
+#include <cstdlib>
+#include <cstring>
+
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Support/raw_ostream.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
 #include <llvm/Transforms/Scalar.h>
-#include <llvm/Transforms/Scalar/Scalarizer.h>
 
 #if LLVM_VERSION_MAJOR >= 13
 #include <llvm/Passes/PassBuilder.h>
 #include <llvm/Passes/PassPlugin.h>
+#include <llvm/Transforms/Scalar/DCE.h>
+#include <llvm/Transforms/Scalar/GVN.h>
+#include <llvm/Transforms/Scalar/LICM.h>
+#include <llvm/Transforms/Scalar/LoopPassManager.h>
+#include <llvm/Transforms/Scalar/SimplifyCFG.h>
 
 #if LLVM_VERSION_MAJOR >= 14
 #include <llvm/Passes/OptimizationLevel.h>
 #else
 using OptimizationLevel = llvm::PassBuilder::OptimizationLevel;
+using GVNPass = llvm::GVN;
 #endif
 #endif
 
@@ -38,22 +47,61 @@ using OptimizationLevel = llvm::PassBuilder::OptimizationLevel;
 
 using namespace llvm;
 
+namespace {
+
+/// The point in the optimization pipeline where we instrument functions (see
+/// SYMCC_PASS_POSITION in docs/Configuration.txt).
+enum class PassPosition { VectorizerStart, OptimizerLast };
+
+PassPosition getPassPosition() {
+  static const PassPosition position = [] {
+    const char *value = getenv("SYMCC_PASS_POSITION");
+    if (value == nullptr || strcmp(value, "vectorizer-start") == 0)
+      return PassPosition::VectorizerStart;
+    if (strcmp(value, "optimizer-last") == 0)
+      return PassPosition::OptimizerLast;
+
+    errs() << "Warning: unknown SYMCC_PASS_POSITION \"" << value
+           << "\", using vectorizer-start\n";
+    return PassPosition::VectorizerStart;
+  }();
+  return position;
+}
+
+/// Whether to optimize the instrumentation after inserting it (see
+/// SYMCC_NO_CLEANUP in docs/Configuration.txt).
+bool cleanupEnabled() { return getenv("SYMCC_NO_CLEANUP") == nullptr; }
+
+} // namespace
+
 //
 // Legacy pass registration (up to LLVM 13)
 //
 
-void addSymbolizeLegacyPass(const PassManagerBuilder & /* unused */,
+void addSymbolizeLegacyPass(const PassManagerBuilder &builder,
                             legacy::PassManagerBase &PM) {
-  PM.add(createScalarizerPass());
   PM.add(createLowerAtomicPass());
   PM.add(new SymbolizeLegacyPass());
+
+  // The instrumentation splits blocks around calls into the runtime and loads
+  // the same globals repeatedly; clean up after ourselves unless we're not
+  // supposed to optimize at all.
+  if (builder.OptLevel > 0 && cleanupEnabled()) {
+    PM.add(createGVNPass());
+    PM.add(createLICMPass());
+    PM.add(createCFGSimplificationPass());
+    PM.add(createDeadCodeEliminationPass());
+  }
 }
 
 // Make the pass known to opt.
 static RegisterPass<SymbolizeLegacyPass> X("symbolize", "Symbolization Pass");
 // Tell frontends to run the pass automatically.
-static struct RegisterStandardPasses Y(PassManagerBuilder::EP_VectorizerStart,
-                                       addSymbolizeLegacyPass);
+static struct RegisterStandardPasses
+    Y(getPassPosition() == PassPosition::OptimizerLast
+          ? PassManagerBuilder::EP_OptimizerLast
+          : PassManagerBuilder::EP_VectorizerStart,
+      addSymbolizeLegacyPass);
 static struct RegisterStandardPasses
     Z(PassManagerBuilder::EP_EnabledOnOptLevel0, addSymbolizeLegacyPass);
 
@@ -63,23 +111,49 @@ static struct RegisterStandardPasses
 
 #if LLVM_VERSION_MAJOR >= 13
 
+namespace {
+
+void addSymbolizePasses(FunctionPassManager &PM, OptimizationLevel level) {
+  PM.addPass(LowerAtomicPass());
+  PM.addPass(SymbolizePass());
+
+  // See addSymbolizeLegacyPass.
+  if (level != OptimizationLevel::O0 && cleanupEnabled()) {
+    PM.addPass(GVNPass());
+    PM.addPass(createFunctionToLoopPassAdaptor(LICMPass(),
+                                               /* UseMemorySSA */ true));
+    PM.addPass(SimplifyCFGPass());
+    PM.addPass(DCEPass());
+  }
+}
+
+} // namespace
+
 PassPluginLibraryInfo getSymbolizePluginInfo() {
   return {LLVM_PLUGIN_API_VERSION, "Symbolization Pass", LLVM_VERSION_STRING,
           [](PassBuilder &PB) {
             // We need to act on the entire module as well as on each function.
-            // Those actions are independent from each other, so we register a
-            // module pass at the start of the pipeline and a function pass just
-            // before the vectorizer. (There doesn't seem to be a way to run
-            // module passes at the start of the vectorizer, hence the split.)
+            // So we register a module pass at the start of the pipeline,
+            // function passes either just before the vectorizer or at the very
+            // end, and another module pass at the end that processes the
+            // results of the function passes (i.e., the site tables). (There
+            // doesn't seem to be a way to run module passes at the start of
+            // the vectorizer, hence the split.)
             PB.registerPipelineStartEPCallback(
                 [](ModulePassManager &PM, OptimizationLevel) {
                   PM.addPass(SymbolizePass());
                 });
-            PB.registerVectorizerStartEPCallback(
-                [](FunctionPassManager &PM, OptimizationLevel) {
-                  PM.addPass(ScalarizerPass());
-                  PM.addPass(LowerAtomicPass());
-                  PM.addPass(SymbolizePass());
+            if (getPassPosition() == PassPosition::VectorizerStart)
+              PB.registerVectorizerStartEPCallback(addSymbolizePasses);
+            PB.registerOptimizerLastEPCallback(
+                [](ModulePassManager &PM, OptimizationLevel level) {
+                  if (getPassPosition() == PassPosition::OptimizerLast) {
+                    FunctionPassManager FPM;
+                    addSymbolizePasses(FPM, level);
+                    PM.addPass(
+                        createModuleToFunctionPassAdaptor(std::move(FPM)));
+                  }
+                  PM.addPass(SymbolizeFinalizationPass());
                 });
           }};
 }
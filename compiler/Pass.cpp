@@ -15,12 +15,16 @@
 #include "Pass.h"
 
 #include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Analysis/AliasAnalysis.h>
 #include <llvm/CodeGen/IntrinsicLowering.h>
 #include <llvm/CodeGen/TargetLowering.h>
 #include <llvm/CodeGen/TargetSubtargetInfo.h>
 #include <llvm/IR/InstIterator.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Support/SpecialCaseList.h>
+#include <llvm/Support/VirtualFileSystem.h>
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Target/TargetOptions.h>
 #include <llvm/Transforms/Utils/ModuleUtils.h>
@@ -51,6 +55,77 @@ namespace {
 
 static constexpr char kSymCtorName[] = "__sym_ctor";
 
+/// Whether to move the slow paths of symbolic computations out of line (see
+/// SYMCC_NO_OUTLINING in docs/Configuration.txt).
+bool outliningEnabled() { return getenv("SYMCC_NO_OUTLINING") == nullptr; }
+
+/// The functions whose arguments only serve as output (see
+/// SYMCC_SINK_FUNCTIONS in docs/Configuration.txt).
+const StringSet<> &sinkFunctions() {
+  static const StringSet<> sinks = [] {
+    const char *value = getenv("SYMCC_SINK_FUNCTIONS");
+    if (value == nullptr) {
+      // Keep in sync with docs/Configuration.txt.
+      return StringSet<>{
+          "printf", "__printf_chk", "fprintf", "__fprintf_chk", "dprintf",
+          "__dprintf_chk", "puts", "fputs", "fputs_unlocked", "putchar",
+          "putchar_unlocked", "putc", "putc_unlocked", "fputc",
+          "fputc_unlocked", "fwrite", "fwrite_unlocked"};
+    }
+
+    StringSet<> result;
+    SmallVector<StringRef, 16> names;
+    StringRef(value).split(names, ',', /* MaxSplit */ -1,
+                           /* KeepEmpty */ false);
+    for (auto name : names)
+      result.insert(name.trim());
+    return result;
+  }();
+  return sinks;
+}
+
+/// Load the list of functions and source files named by the given environment
+/// variable (see SYMCC_INSTRUMENT_ALLOWLIST and SYMCC_INSTRUMENT_DENYLIST in
+/// docs/Configuration.txt). Returns null if the variable isn't set or the list
+/// can't be loaded.
+std::unique_ptr<SpecialCaseList> loadFunctionList(const char *variable) {
+  const char *path = getenv(variable);
+  if (path == nullptr)
+    return nullptr;
+
+  std::string error;
+#if LLVM_VERSION_MAJOR >= 10
+  auto list =
+      SpecialCaseList::create({path}, *vfs::getRealFileSystem(), error);
+#else
+  auto list = SpecialCaseList::create({path}, error);
+#endif
+  if (!list) {
+    errs() << "Warning: ignoring " << variable << ": " << error << '\n';
+    return nullptr;
+  }
+
+  return list;
+}
+
+/// Check whether a function matches a list of functions and source files.
+bool matchesFunctionList(const SpecialCaseList &list, const Function &F) {
+  return list.inSection("symcc", "fun", F.getName()) ||
+         list.inSection("symcc", "src", F.getParent()->getSourceFileName());
+}
+
+/// Whether to track the computations of the given function, or just to keep
+/// the shadow consistent (see SYMCC_INSTRUMENT_ALLOWLIST and
+/// SYMCC_INSTRUMENT_DENYLIST in docs/Configuration.txt).
+bool shouldSymbolize(const Function &F) {
+  static const auto allowlist = loadFunctionList("SYMCC_INSTRUMENT_ALLOWLIST");
+  static const auto denylist = loadFunctionList("SYMCC_INSTRUMENT_DENYLIST");
+
+  if (allowlist && !matchesFunctionList(*allowlist, F))
+    return false;
+  return !(denylist && matchesFunctionList(*denylist, F));
+}
+
 bool instrumentModule(Module &M) {
   DEBUG(errs() << "Symbolizer module instrumentation\n");
 
@@ -76,6 +151,10 @@ bool canLower(const CallInst *CI) {
   if (!Callee)
     return false;
 
+  // IntrinsicLowering only handles scalars.
+  if (CI->getType()->isVectorTy())
+    return false;
+
   switch (Callee->getIntrinsicID()) {
   case Intrinsic::expect:
   case Intrinsic::ctpop:
@@ -155,11 +234,22 @@ void liftInlineAssembly(CallInst *CI) {
   targetLowering->ExpandInlineAsm(CI);
 }
 
-bool instrumentFunction(Function &F) {
+bool instrumentFunction(Function &F, AAResults &AA) {
   auto functionName = F.getName();
-  if (functionName == kSymCtorName || functionName.startswith("sym_asan"))
+  if (functionName == kSymCtorName || functionName.startswith("sym_asan") ||
+      functionName.startswith(Symbolizer::kSlowPathPrefix))
     return false;
 
+  if (!shouldSymbolize(F)) {
+    DEBUG(errs() << "Concretizing function ");
+    DEBUG(errs().write_escaped(functionName) << '\n');
+
+    Symbolizer(*F.getParent()).concretizeFunction(F);
+    assert(!verifyFunction(F, &errs()) &&
+           "SymbolizePass produced invalid bitcode");
+    return true;
+  }
+
   DEBUG(errs() << "Symbolizing function ");
   DEBUG(errs().write_escaped(functionName) << '\n');
 
@@ -184,16 +274,24 @@ bool instrumentFunction(Function &F) {
     allInstructions.push_back(&I);
 
   Symbolizer symbolizer(*F.getParent());
+  symbolizer.findRedundantLoads(F, AA);
+  symbolizer.findAccessGroups(F, AA);
+  symbolizer.findSinkOnlyValues(F, sinkFunctions());
   symbolizer.symbolizeFunctionArguments(F);
 
   for (auto &basicBlock : F)
     symbolizer.insertBasicBlockNotification(basicBlock);
 
-  for (auto *instPtr : allInstructions)
-    symbolizer.visit(instPtr);
+  for (auto *instPtr : allInstructions) {
+    if (!symbolizer.isSinkOnly(*instPtr))
+      symbolizer.visit(instPtr);
+  }
 
   symbolizer.finalizePHINodes();
   symbolizer.shortCircuitExpressionUses();
+  if (outliningEnabled())
+    symbolizer.outlineSlowPaths();
+  symbolizer.emitSiteTable();
 
   // DEBUG(errs() << F << '\n');
   assert(!verifyFunction(F, &errs()) &&
@@ -202,21 +300,37 @@ bool instrumentFunction(Function &F) {
   return true;
 }
 
+bool finalizeModule(Module &M) {
+  Symbolizer::emitModuleSiteTable(M, M.getFunction(kSymCtorName));
+  return true;
+}
+
 } // namespace
 
 bool SymbolizeLegacyPass::doInitialization(Module &M) {
   return instrumentModule(M);
 }
 
+bool SymbolizeLegacyPass::doFinalization(Module &M) {
+  return finalizeModule(M);
+}
+
+void SymbolizeLegacyPass::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<AAResultsWrapperPass>();
+}
+
 bool SymbolizeLegacyPass::runOnFunction(Function &F) {
-  return instrumentFunction(F);
+  return instrumentFunction(F,
+                            getAnalysis<AAResultsWrapperPass>().getAAResults());
 }
 
 #if LLVM_VERSION_MAJOR >= 13
 
-PreservedAnalyses SymbolizePass::run(Function &F, FunctionAnalysisManager &) {
-  return instrumentFunction(F) ? PreservedAnalyses::none()
-                               : PreservedAnalyses::all();
+PreservedAnalyses SymbolizePass::run(Function &F,
+                                     FunctionAnalysisManager &FAM) {
+  return instrumentFunction(F, FAM.getResult<AAManager>(F))
+             ? PreservedAnalyses::none()
+             : PreservedAnalyses::all();
 }
 
 PreservedAnalyses SymbolizePass::run(Module &M, ModuleAnalysisManager &) {
@@ -224,4 +338,10 @@ PreservedAnalyses SymbolizePass::run(Module &M, ModuleAnalysisManager &) {
                              : PreservedAnalyses::all();
 }
 
+PreservedAnalyses SymbolizeFinalizationPass::run(Module &M,
+                                                 ModuleAnalysisManager &) {
+  return finalizeModule(M) ? PreservedAnalyses::none()
+                           : PreservedAnalyses::all();
+}
+
 #endif
@@ -29,7 +29,9 @@ public:
 
   SymbolizeLegacyPass() : FunctionPass(ID) {}
 
+  virtual void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
   virtual bool doInitialization(llvm::Module &M) override;
+  virtual bool doFinalization(llvm::Module &M) override;
   virtual bool runOnFunction(llvm::Function &F) override;
 };
 
@@ -44,6 +46,16 @@ public:
   static bool isRequired() { return true; }
 };
 
+/// Work that needs to happen after all functions of a module have been
+/// instrumented by SymbolizePass (i.e., emitting the module's site table).
+class SymbolizeFinalizationPass
+    : public llvm::PassInfoMixin<SymbolizeFinalizationPass> {
+public:
+  llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &);
+
+  static bool isRequired() { return true; }
+};
+
 #endif
 
 #endif
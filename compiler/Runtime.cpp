@@ -72,6 +72,8 @@ Runtime::Runtime(Module &M) {
   buildConcat =
       import(M, "_sym_concat_helper", ptrT, ptrT,
              ptrT); // doesn't follow naming convention for historic reasons
+  buildExtractBits = import(M, "_sym_extract_helper", ptrT, ptrT, intPtrType,
+                            intPtrType); // likewise
   pushPathConstraint =
       import(M, "_sym_push_path_constraint", voidT, ptrT, int1T, intPtrType);
 
@@ -96,12 +98,13 @@ Runtime::Runtime(Module &M) {
       import(M, "_sym_build_funnel_shift_right", ptrT, ptrT, ptrT, ptrT);
   buildAbs = import(M, "_sym_build_abs", ptrT, ptrT);
 
-  setParameterExpression =
-      import(M, "_sym_set_parameter_expression", voidT, int8T, ptrT);
-  getParameterExpression =
-      import(M, "_sym_get_parameter_expression", ptrT, int8T);
-  setReturnExpression = import(M, "_sym_set_return_expression", voidT, ptrT);
-  getReturnExpression = import(M, "_sym_get_return_expression", ptrT);
+  argumentMask = M.getOrInsertGlobal("_sym_argument_mask",
+                                    IRB.getIntNTy(kArgumentMaskBits));
+  argumentExpressions = M.getOrInsertGlobal(
+      "_sym_argument_expressions", ArrayType::get(ptrT, kMaxFunctionArguments));
+  returnExpression = M.getOrInsertGlobal("_sym_return_expression", ptrT);
+  shadowSummary = M.getOrInsertGlobal(
+      "_sym_shadow_summary", ArrayType::get(int8T, kShadowSummaryEntries));
 
 #define LOAD_BINARY_OPERATOR_HANDLER(constant, name)                           \
   binaryOperatorHandlers[Instruction::constant] =                              \
@@ -178,6 +181,12 @@ Runtime::Runtime(Module &M) {
       import(M, "_sym_read_memory", ptrT, intPtrType, intPtrType, int1T);
   writeMemory = import(M, "_sym_write_memory", voidT, intPtrType, intPtrType,
                        ptrT, int1T);
+  readMemoryMulti =
+      import(M, "_sym_read_memory_multi", voidT, intPtrType, intPtrType,
+             intPtrType->getPointerTo(), ptrT->getPointerTo(), int1T);
+  writeMemoryMulti =
+      import(M, "_sym_write_memory_multi", voidT, intPtrType, intPtrType,
+             intPtrType->getPointerTo(), ptrT->getPointerTo(), int1T);
   buildZeroBytes = import(M, "_sym_build_zero_bytes", ptrT, intPtrType);
   buildInsert =
       import(M, "_sym_build_insert", ptrT, ptrT, ptrT, IRB.getInt64Ty(), int1T);
@@ -186,7 +195,12 @@ Runtime::Runtime(Module &M) {
 
   notifyCall = import(M, "_sym_notify_call", voidT, intPtrType);
   notifyRet = import(M, "_sym_notify_ret", voidT, intPtrType);
+  concretizeReturn = import(M, "_sym_concretize_return", ptrT, intPtrType,
+                            ptrT, IRB.getInt64Ty());
   notifyBasicBlock = import(M, "_sym_notify_basic_block", voidT, intPtrType);
+  registerSites =
+      import(M, "_sym_register_sites", voidT, intPtrType, ptrT, intPtrType);
+  release = import(M, "_sym_release", voidT, ptrT);
 }
 
 /// Decide whether a function is called symbolically.
@@ -196,7 +210,8 @@ bool isInterceptedFunction(const Function &f) {
       "lseek",  "lseek64", "fopen",    "fopen64", "fread",   "fseek",
       "fseeko", "rewind",  "fseeko64", "getc",    "ungetc",  "memcpy",
       "memset", "strncpy", "strchr",   "memcmp",  "memmove", "ntohl",
-      "fgets",  "fgetc",   "getchar",  "bcopy",   "bcmp",    "bzero"};
+      "fgets",  "fgetc",   "getchar",  "bcopy",   "bcmp",    "bzero",
+      "munmap"};
 
   return (kInterceptedFunctions.count(f.getName()) > 0);
 }
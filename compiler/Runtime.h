@@ -24,6 +24,16 @@ using SymFnT = llvm::Value *;
 using SymFnT = llvm::FunctionCallee;
 #endif
 
+/// The number of argument slots in the runtime, and the width of the mask of
+/// symbolic arguments (see the function-call helpers in RuntimeCommon.h).
+constexpr unsigned kMaxFunctionArguments = 256;
+constexpr unsigned kArgumentMaskBits = 64;
+
+/// The layout of the shadow summary that instrumented code checks before
+/// accessing memory (see the memory-management functions in RuntimeCommon.h).
+constexpr unsigned kShadowSummaryGranularityBits = 16;
+constexpr uint64_t kShadowSummaryEntries = uint64_t(1) << 24;
+
 /// Runtime functions
 struct Runtime {
   Runtime(llvm::Module &M);
@@ -64,22 +74,34 @@ struct Runtime {
   SymFnT buildFshr{};
   SymFnT buildAbs{};
   SymFnT buildConcat{};
+  SymFnT buildExtractBits{};
   SymFnT pushPathConstraint{};
-  SymFnT getParameterExpression{};
-  SymFnT setParameterExpression{};
-  SymFnT setReturnExpression{};
-  SymFnT getReturnExpression{};
   SymFnT memcpy{};
   SymFnT memset{};
   SymFnT memmove{};
   SymFnT readMemory{};
   SymFnT writeMemory{};
+  SymFnT readMemoryMulti{};
+  SymFnT writeMemoryMulti{};
   SymFnT buildZeroBytes{};
   SymFnT buildInsert{};
   SymFnT buildExtract{};
   SymFnT notifyCall{};
   SymFnT notifyRet{};
+  SymFnT concretizeReturn{};
   SymFnT notifyBasicBlock{};
+  SymFnT registerSites{};
+  SymFnT release{};
+
+  /// Variables of the function-call ABI that instrumented code accesses
+  /// directly (see RuntimeCommon.h).
+  llvm::Constant *argumentMask{};
+  llvm::Constant *argumentExpressions{};
+  llvm::Constant *returnExpression{};
+
+  /// The shadow summary, which instrumented code uses to skip memory accesses
+  /// that can't involve symbolic data (see RuntimeCommon.h).
+  llvm::Constant *shadowSummary{};
 
   /// Mapping from icmp predicates to the functions that build the corresponding
   /// symbolic expressions.
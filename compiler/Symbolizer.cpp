@@ -15,33 +15,392 @@
 #include "Symbolizer.h"
 
 #include <cstdint>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DepthFirstIterator.h>
 #include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/ADT/StringSwitch.h>
+#include <llvm/Analysis/MemorySSA.h>
+#include <llvm/Analysis/ValueTracking.h>
 #include <llvm/IR/Constants.h>
+#include <llvm/IR/DebugInfoMetadata.h>
+#include <llvm/IR/Dominators.h>
 #include <llvm/IR/GetElementPtrTypeIterator.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/IntrinsicInst.h>
 #include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/Support/xxhash.h>
 #include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <llvm/Transforms/Utils/CodeExtractor.h>
 
 #include "Runtime.h"
 
 using namespace llvm;
 
+namespace {
+
+/// The named metadata holding the number of sites in the module so far.
+constexpr char kSiteCountMetadata[] = "symcc.site_count";
+
+/// The name of the per-function site tables (see emitModuleSiteTable).
+constexpr char kFunctionSiteTableName[] = "__sym_function_sites";
+
+/// Return the module part of the module's site IDs, i.e., a hash of the source
+/// file name shifted past the site index.
+uint64_t getModuleSiteKey(const Module &M, unsigned indexBits) {
+  auto hash = xxHash64(M.getSourceFileName());
+  return (hash << indexBits) & maskTrailingOnes<uint64_t>(2 * indexBits);
+}
+
+/// Return the number of lanes of a vector type, or zero if the number isn't
+/// known at compile time (i.e., for scalable vectors, which we don't support).
+unsigned getNumLanes(Type *vectorType) {
+#if LLVM_VERSION_MAJOR >= 11
+  if (auto *fixedType = dyn_cast<FixedVectorType>(vectorType))
+    return fixedType->getNumElements();
+  return 0;
+#else
+  auto *type = cast<VectorType>(vectorType);
+#if LLVM_VERSION_MAJOR >= 9
+  if (type->isScalable())
+    return 0;
+#endif
+  return type->getNumElements();
+#endif
+}
+
+/// Check whether a call builds an expression that the runtime hands out as a
+/// new reference (see _sym_release), keeping no references to the argument
+/// expressions other than through the result. This holds for the backends'
+/// expression builders except for those returning shared constants, and the
+/// aggregate helper _sym_build_insert may return its argument unchanged.
+bool buildsNewExpression(const CallInst *call) {
+  auto *callee = call->getCalledFunction();
+  if (callee == nullptr || !callee->getName().startswith("_sym_build_"))
+    return false;
+
+  return !StringSwitch<bool>(callee->getName())
+              .Cases("_sym_build_true", "_sym_build_false", "_sym_build_bool",
+                     "_sym_build_null_pointer", "_sym_build_insert", true)
+              .Default(false);
+}
+
+/// Return the type of the value that a load or store accesses.
+Type *getAccessedType(Instruction *access) {
+  if (auto *store = dyn_cast<StoreInst>(access))
+    return store->getValueOperand()->getType();
+  return cast<LoadInst>(access)->getType();
+}
+
+/// A run of adjacent loads or stores under construction (see
+/// Symbolizer::findAccessGroups).
+struct OpenAccessGroup {
+  SmallVector<Instruction *, 4> accesses;
+  Value *base = nullptr;
+  int64_t end = 0; // the offset from base where the next access has to start
+  uint64_t size = 0;
+
+  bool canAppend(Value *accessBase, int64_t offset, uint64_t accessSize,
+                 unsigned maxAccesses, uint64_t maxSize) const {
+    return !accesses.empty() && accessBase == base && offset == end &&
+           accesses.size() < maxAccesses && size + accessSize <= maxSize;
+  }
+
+  void append(Instruction *access, Value *accessBase, int64_t offset,
+              uint64_t accessSize) {
+    if (accesses.empty()) {
+      base = accessBase;
+      end = offset;
+    }
+    accesses.push_back(access);
+    end += accessSize;
+    size += accessSize;
+  }
+};
+
+} // namespace
+
 void Symbolizer::symbolizeFunctionArguments(Function &F) {
   // The main function doesn't receive symbolic arguments.
   if (F.getName() == "main")
     return;
 
+  if (std::all_of(F.arg_begin(), F.arg_end(),
+                  [](Argument &arg) { return arg.user_empty(); }))
+    return;
+
+  // Read and clear the mask of symbolic arguments; arguments whose bit isn't
+  // set are concrete, and we mustn't look at their slots (see the function-call
+  // helpers in RuntimeCommon.h). Everything happens inline, so calls with
+  // concrete arguments never enter the runtime.
   IRBuilder<> IRB(F.getEntryBlock().getFirstNonPHI());
+  auto *maskType = IRB.getIntNTy(kArgumentMaskBits);
+  auto *mask = IRB.CreateLoad(maskType, runtime.argumentMask);
+  IRB.CreateStore(ConstantInt::get(maskType, 0), runtime.argumentMask);
 
+  auto *slotsType = ArrayType::get(IRB.getInt8PtrTy(), kMaxFunctionArguments);
   for (auto &arg : F.args()) {
-    if (!arg.user_empty())
-      symbolicExpressions[&arg] = IRB.CreateCall(runtime.getParameterExpression,
-                                                 IRB.getInt8(arg.getArgNo()));
+    // Arguments without a slot are always concrete.
+    auto argNo = arg.getArgNo();
+    if (arg.user_empty() || argNo >= kMaxFunctionArguments)
+      continue;
+
+    auto *bit = ConstantInt::get(
+        maskType, APInt::getOneBitSet(kArgumentMaskBits,
+                                      std::min(argNo, kArgumentMaskBits - 1)));
+    auto *isSymbolic = IRB.CreateICmpNE(IRB.CreateAnd(mask, bit),
+                                        ConstantInt::get(maskType, 0));
+    auto *slot = IRB.CreateConstInBoundsGEP2_64(
+        slotsType, runtime.argumentExpressions, 0, argNo);
+    symbolicExpressions[&arg] =
+        IRB.CreateSelect(isSymbolic, IRB.CreateLoad(IRB.getInt8PtrTy(), slot),
+                         ConstantPointerNull::get(IRB.getInt8PtrTy()));
+  }
+}
+
+void Symbolizer::concretizeFunction(Function &F) {
+  SmallVector<Instruction *, 0> allInstructions;
+  for (auto &I : instructions(F))
+    allInstructions.push_back(&I);
+
+  auto *nullExpression =
+      ConstantPointerNull::get(Type::getInt8PtrTy(F.getContext()));
+  for (auto *I : allInstructions) {
+    IRBuilder<> IRB(I);
+
+    if (auto *store = dyn_cast<StoreInst>(I)) {
+      // The stored value is concrete as far as we're concerned, so any shadow
+      // of the target memory is out of date.
+      auto *addr = store->getPointerOperand();
+      auto *dataType = store->getValueOperand()->getType();
+      uint64_t dataSize = dataLayout.getTypeStoreSize(dataType);
+      if (canCheckShadowSummary(dataSize)) {
+        IRB.SetInsertPoint(
+            SplitBlockAndInsertIfThen(createShadowSummaryCheck(IRB, addr),
+                                      store, /* unreachable */ false));
+      }
+      IRB.CreateCall(runtime.writeMemory,
+                     {IRB.CreatePtrToInt(addr, intPtrType),
+                      ConstantInt::get(intPtrType, dataSize), nullExpression,
+                      IRB.getInt1(isLittleEndian(dataType) ? 1 : 0)});
+    } else if (auto *memIntrinsic = dyn_cast<AnyMemIntrinsic>(I)) {
+      // Copying, moving and setting memory all leave the destination concrete.
+      IRB.CreateCall(
+          runtime.memset,
+          {memIntrinsic->getRawDest(), nullExpression,
+           IRB.CreateZExtOrTrunc(memIntrinsic->getLength(), intPtrType)});
+    } else if (auto *call = dyn_cast<CallBase>(I)) {
+      auto *callee = call->getCalledFunction();
+      if (call->isInlineAsm() || (callee != nullptr && callee->isIntrinsic()))
+        continue;
+
+      IRB.CreateStore(ConstantInt::get(IRB.getIntNTy(kArgumentMaskBits), 0),
+                      runtime.argumentMask);
+    } else if (auto *ret = dyn_cast<ReturnInst>(I)) {
+      // Our callees may have left their return expressions behind, so we
+      // need to clear the return expression explicitly.
+      if (ret->getReturnValue() != nullptr)
+        IRB.CreateStore(nullExpression, runtime.returnExpression);
+    }
+  }
+}
+
+void Symbolizer::findRedundantLoads(Function &F, AAResults &AA) {
+  SmallVector<LoadInst *, 0> loads;
+  for (auto &I : instructions(F)) {
+    auto *load = dyn_cast<LoadInst>(&I);
+    if (load != nullptr && load->isSimple())
+      loads.push_back(load);
+  }
+  if (loads.size() < 2)
+    return;
+
+  DominatorTree DT(F);
+  MemorySSA MSSA(F, &AA, &DT);
+  auto *walker = MSSA.getWalker();
+
+  // Visit the blocks in dominator-tree order, so that we've seen all
+  // candidates for an earlier load by the time we get to the later one.
+  DenseMap<std::pair<Value *, Type *>, SmallVector<LoadInst *, 2>>
+      earlierLoads;
+  for (auto *node : depth_first(DT.getRootNode())) {
+    for (auto &I : *node->getBlock()) {
+      auto *load = dyn_cast<LoadInst>(&I);
+      if (load == nullptr || !load->isSimple())
+        continue;
+
+      // If the nearest write that may clobber the location dominates an
+      // earlier load of the same address, nothing can have written to the
+      // location between the two loads.
+      auto &candidates = earlierLoads[{
+          load->getPointerOperand()->stripPointerCasts(), load->getType()}];
+      auto *clobber = walker->getClobberingMemoryAccess(load);
+      auto earlier =
+          std::find_if(candidates.begin(), candidates.end(), [&](auto *other) {
+            return DT.dominates(other, load) &&
+                   MSSA.dominates(clobber, MSSA.getMemoryAccess(other));
+          });
+      if (earlier != candidates.end())
+        redundantLoads[load] = *earlier;
+      else
+        candidates.push_back(load);
+    }
+  }
+}
+
+void Symbolizer::findAccessGroups(Function &F, AAResults &AA) {
+  // Runs of accesses must be small enough for a single check of the shadow
+  // summary.
+  const uint64_t maxSize = uint64_t(1) << kShadowSummaryGranularityBits;
+
+  for (auto &block : F) {
+    OpenAccessGroup loads, stores;
+    // The stores since the start of the current run of loads: the shadow of
+    // later loads in the run is read before them.
+    SmallVector<Instruction *, 8> storesSinceLoads;
+
+    auto close = [this](OpenAccessGroup &group) {
+      if (group.accesses.size() > 1) {
+        for (auto *access : group.accesses)
+          accessGroupIndices[access] = accessGroups.size();
+        accessGroups.push_back(std::move(group.accesses));
+      }
+      group = OpenAccessGroup();
+    };
+
+    for (auto &I : block) {
+      auto *load = dyn_cast<LoadInst>(&I);
+      auto *store = dyn_cast<StoreInst>(&I);
+      bool isCandidate = (load != nullptr && load->isSimple() &&
+                          !redundantLoads.count(load)) ||
+                         (store != nullptr && store->isSimple());
+      if (isCandidate) {
+        auto *type = getAccessedType(&I);
+        isCandidate = type->isIntOrPtrTy() || type->isFloatingPointTy();
+      }
+
+      if (!isCandidate) {
+        // We don't know how other memory accesses (e.g., calls) relate to the
+        // runs, so we end them.
+        if (I.mayReadOrWriteMemory()) {
+          close(loads);
+          close(stores);
+          storesSinceLoads.clear();
+        }
+        continue;
+      }
+
+      auto location = MemoryLocation::get(&I);
+      auto accessSize = dataLayout.getTypeStoreSize(getAccessedType(&I));
+      int64_t offset = 0;
+      auto *base = GetPointerBaseWithConstantOffset(
+          const_cast<Value *>(location.Ptr), offset, dataLayout);
+      auto mayAlias = [&](Instruction *other) {
+        return !AA.isNoAlias(MemoryLocation::get(other), location);
+      };
+
+      if (load != nullptr) {
+        // The shadow for the pending run of stores is written after this load,
+        // so the load must not read any of it.
+        if (std::any_of(stores.accesses.begin(), stores.accesses.end(),
+                        mayAlias))
+          close(stores);
+
+        if (!loads.canAppend(base, offset, accessSize, kMaxAccessGroupSize,
+                             maxSize) ||
+            std::any_of(storesSinceLoads.begin(), storesSinceLoads.end(),
+                        mayAlias)) {
+          close(loads);
+          storesSinceLoads.clear();
+        }
+        loads.append(load, base, offset, accessSize);
+      } else {
+        if (!loads.accesses.empty())
+          storesSinceLoads.push_back(store);
+
+        // Stores in a run don't overlap, so writing their shadow at the last
+        // one doesn't change the result.
+        if (!stores.canAppend(base, offset, accessSize, kMaxAccessGroupSize,
+                              maxSize))
+          close(stores);
+        stores.append(store, base, offset, accessSize);
+      }
+    }
+
+    close(loads);
+    close(stores);
+  }
+}
+
+void Symbolizer::findSinkOnlyValues(Function &F, const StringSet<> &sinks) {
+  if (sinks.empty())
+    return;
+
+  // Instructions that we can skip without losing anything but the expression
+  // of their result; in particular, their instrumentation doesn't push path
+  // constraints (unlike, e.g., selects or loads, which try alternative
+  // addresses).
+  auto isCandidate = [](Instruction &I) {
+    return isa<BinaryOperator>(I) || isa<UnaryOperator>(I) ||
+           isa<CastInst>(I) || isa<CmpInst>(I) || isa<GetElementPtrInst>(I) ||
+           isa<PHINode>(I) || isa<ExtractValueInst>(I) ||
+           isa<InsertValueInst>(I) || isa<ShuffleVectorInst>(I);
+  };
+
+  auto isSinkArgument = [&](Use &U) {
+    auto *call = dyn_cast<CallInst>(U.getUser());
+    if (call == nullptr || !call->isArgOperand(&U))
+      return false;
+
+    auto *callee = call->getCalledFunction();
+    return callee != nullptr && sinks.count(callee->getName()) > 0;
+  };
+
+  // Start optimistically with all candidates, and remove those with other
+  // uses until nothing changes; this handles cycles through PHI nodes.
+  SmallVector<Instruction *, 0> worklist;
+  for (auto &I : instructions(F)) {
+    if (isCandidate(I) && !I.use_empty()) {
+      sinkOnlyValues.insert(&I);
+      worklist.push_back(&I);
+    }
+  }
+
+  while (!worklist.empty()) {
+    auto *I = worklist.pop_back_val();
+    if (!sinkOnlyValues.count(I))
+      continue;
+
+    bool onlySinks = std::all_of(I->use_begin(), I->use_end(), [&](Use &U) {
+      auto *user = dyn_cast<Instruction>(U.getUser());
+      return user != nullptr &&
+             (sinkOnlyValues.count(user) > 0 || isSinkArgument(U));
+    });
+    if (onlySinks)
+      continue;
+
+    sinkOnlyValues.erase(I);
+    for (auto &operand : I->operands()) {
+      if (auto *operandInst = dyn_cast<Instruction>(operand);
+          operandInst != nullptr && sinkOnlyValues.count(operandInst))
+        worklist.push_back(operandInst);
+    }
   }
 }
 
 void Symbolizer::insertBasicBlockNotification(llvm::BasicBlock &B) {
+  // Attribute the block to the first instruction with a source location.
+  auto *locationInst = &*B.getFirstInsertionPt();
+  for (auto &I : B) {
+    if (I.getDebugLoc()) {
+      locationInst = &I;
+      break;
+    }
+  }
+
   IRBuilder<> IRB(&*B.getFirstInsertionPt());
-  IRB.CreateCall(runtime.notifyBasicBlock, getTargetPreferredInt(&B));
+  IRB.CreateCall(runtime.notifyBasicBlock,
+                 createSiteId(locationInst, SiteKind::BasicBlock));
 }
 
 void Symbolizer::finalizePHINodes() {
@@ -80,24 +439,87 @@ void Symbolizer::finalizePHINodes() {
   symbolicExpressions.clear();
 }
 
+std::vector<SmallVector<unsigned,
+                        Symbolizer::kExpectedSymbolicArgumentsPerComputation>>
+Symbolizer::findDeadInputs() const {
+  std::vector<SmallVector<unsigned, kExpectedSymbolicArgumentsPerComputation>>
+      deadInputs(expressionUses.size());
+
+  for (size_t i = 0; i < expressionUses.size(); i++) {
+    const auto &inputs = expressionUses[i].inputs;
+    SmallPtrSet<Instruction *, kExpectedSymbolicArgumentsPerComputation>
+        inputUsers;
+    for (const auto &input : inputs)
+      inputUsers.insert(input.user);
+
+    // The computation must not pass the expression on or keep it (e.g., by
+    // storing it in memory), and it must run at most once per expression;
+    // requiring the same basic block rules out uses in a loop, for example.
+    auto isConsumingUse = [&](User *U, BasicBlock *block) {
+      auto *call = dyn_cast<CallInst>(U);
+      if (call == nullptr || call->getParent() != block ||
+          inputUsers.count(call) == 0)
+        return false;
+
+      auto *callee = call->getCalledFunction();
+      return buildsNewExpression(call) ||
+             (callee != nullptr &&
+              callee->getName() == "_sym_push_path_constraint");
+    };
+
+    SmallPtrSet<Value *, kExpectedSymbolicArgumentsPerComputation> seen;
+    for (unsigned j = 0; j < inputs.size(); j++) {
+      auto *expr = dyn_cast<CallInst>(inputs[j].getSymbolicOperand());
+      if (expr == nullptr || !seen.insert(expr).second ||
+          !buildsNewExpression(expr))
+        continue;
+
+      if (std::all_of(expr->user_begin(), expr->user_end(), [&](User *U) {
+            return isConsumingUse(U, expr->getParent());
+          }))
+        deadInputs[i].push_back(j);
+    }
+  }
+
+  return deadInputs;
+}
+
 void Symbolizer::shortCircuitExpressionUses() {
-  for (auto &symbolicComputation : expressionUses) {
+  auto deadInputs = findDeadInputs();
+
+  for (size_t computationIndex = 0; computationIndex < expressionUses.size();
+       computationIndex++) {
+    auto &symbolicComputation = expressionUses[computationIndex];
     assert(!symbolicComputation.inputs.empty() &&
            "Symbolic computation has no inputs");
 
+    // Remember the dead expressions before we replace any operands. If the
+    // computation that created an expression has been short-circuited already,
+    // the operand is the PHI node merging it with null.
+    SmallVector<Value *, kExpectedSymbolicArgumentsPerComputation>
+        deadExpressions;
+    for (auto inputIndex : deadInputs[computationIndex]) {
+      deadExpressions.push_back(
+          symbolicComputation.inputs[inputIndex].getSymbolicOperand());
+    }
+
     IRBuilder<> IRB(symbolicComputation.firstInstruction);
 
     // Build the check whether any input expression is non-null (i.e., there
-    // is a symbolic input).
+    // is a symbolic input). The same value may be used several times (e.g.,
+    // once per lane of a vector), so we check each value only once.
     auto *nullExpression = ConstantPointerNull::get(IRB.getInt8PtrTy());
-    std::vector<Value *> nullChecks;
+    SmallDenseMap<Value *, Value *, kExpectedSymbolicArgumentsPerComputation>
+        nullChecks;
+    Value *allConcrete = nullptr;
     for (const auto &input : symbolicComputation.inputs) {
-      nullChecks.push_back(
-          IRB.CreateICmpEQ(nullExpression, input.getSymbolicOperand()));
-    }
-    auto *allConcrete = nullChecks[0];
-    for (unsigned argIndex = 1; argIndex < nullChecks.size(); argIndex++) {
-      allConcrete = IRB.CreateAnd(allConcrete, nullChecks[argIndex]);
+      auto &nullCheck = nullChecks[input.concreteValue];
+      if (nullCheck != nullptr)
+        continue;
+
+      nullCheck = IRB.CreateICmpEQ(nullExpression, input.getSymbolicOperand());
+      allConcrete =
+          allConcrete ? IRB.CreateAnd(allConcrete, nullCheck) : nullCheck;
     }
 
     // The main branch: if we don't enter here, we can short-circuit the
@@ -107,20 +529,26 @@ void Symbolizer::shortCircuitExpressionUses() {
     auto *slowPath = SplitBlock(head, symbolicComputation.firstInstruction);
     auto *tail = SplitBlock(slowPath,
                             symbolicComputation.lastInstruction->getNextNode());
-    ReplaceInstWithInst(head->getTerminator(),
-                        BranchInst::Create(tail, slowPath, allConcrete));
+    auto *branch = BranchInst::Create(tail, slowPath, allConcrete);
+    branch->setMetadata(LLVMContext::MD_prof,
+                        MDBuilder(IRB.getContext())
+                            .createBranchWeights(kConcretePathWeight, 1));
+    ReplaceInstWithInst(head->getTerminator(), branch);
+    slowPaths.emplace_back(slowPath, tail);
 
     // In the slow case, we need to check each input expression for null
     // (i.e., the input is concrete) and create an expression from the
     // concrete value if necessary.
-    auto numUnknownConcreteness = std::count_if(
-        symbolicComputation.inputs.begin(), symbolicComputation.inputs.end(),
-        [&](const Input &input) {
-          return (input.getSymbolicOperand() != nullExpression);
-        });
-    for (unsigned argIndex = 0; argIndex < symbolicComputation.inputs.size();
-         argIndex++) {
-      auto &argument = symbolicComputation.inputs[argIndex];
+    SmallPtrSet<Value *, kExpectedSymbolicArgumentsPerComputation>
+        unknownConcreteness;
+    for (const auto &input : symbolicComputation.inputs) {
+      if (input.getSymbolicOperand() != nullExpression)
+        unknownConcreteness.insert(input.concreteValue);
+    }
+    auto numUnknownConcreteness = unknownConcreteness.size();
+    SmallDenseMap<Value *, Value *, kExpectedSymbolicArgumentsPerComputation>
+        finalArgExpressions;
+    for (auto &argument : symbolicComputation.inputs) {
       auto *originalArgExpression = argument.getSymbolicOperand();
       auto *argCheckBlock = symbolicComputation.firstInstruction->getParent();
 
@@ -134,9 +562,17 @@ void Symbolizer::shortCircuitExpressionUses() {
       if (needRuntimeCheck && (numUnknownConcreteness == 1))
         continue;
 
+      // If we've seen the value before, reuse its expression.
+      auto &finalArgExpression = finalArgExpressions[argument.concreteValue];
+      if (finalArgExpression != nullptr) {
+        argument.replaceOperand(finalArgExpression);
+        continue;
+      }
+
       if (needRuntimeCheck) {
         auto *argExpressionBlock = SplitBlockAndInsertIfThen(
-            nullChecks[argIndex], symbolicComputation.firstInstruction,
+            nullChecks[argument.concreteValue],
+            symbolicComputation.firstInstruction,
             /* unreachable */ false);
         IRB.SetInsertPoint(argExpressionBlock);
       } else {
@@ -146,7 +582,6 @@ void Symbolizer::shortCircuitExpressionUses() {
       auto *newArgExpression =
           createValueExpression(argument.concreteValue, IRB);
 
-      Value *finalArgExpression;
       if (needRuntimeCheck) {
         IRB.SetInsertPoint(symbolicComputation.firstInstruction);
         auto *argPHI = IRB.CreatePHI(IRB.getInt8PtrTy(), 2);
@@ -160,6 +595,15 @@ void Symbolizer::shortCircuitExpressionUses() {
       argument.replaceOperand(finalArgExpression);
     }
 
+    // Any symbolic input leads to the slow path, so this is the right place
+    // to release dead inputs; null expressions are fine.
+    if (!deadExpressions.empty()) {
+      IRB.SetInsertPoint(
+          symbolicComputation.lastInstruction->getParent()->getTerminator());
+      for (auto *expr : deadExpressions)
+        IRB.CreateCall(runtime.release, expr);
+    }
+
     // Finally, the overall result (if the computation produces one) is null
     // if we've taken the fast path and the symbolic expression computed above
     // if short-circuiting wasn't possible.
@@ -176,9 +620,68 @@ void Symbolizer::shortCircuitExpressionUses() {
   }
 }
 
+void Symbolizer::outlineSlowPaths() {
+#if LLVM_VERSION_MAJOR >= 11
+  if (slowPaths.empty())
+    return;
+
+  auto *F = slowPaths.front().first->getParent();
+  CodeExtractorAnalysisCache analysisCache(*F);
+  for (auto [entry, exit] : slowPaths) {
+    // A slow path may have ended up inside another one that we've outlined
+    // already.
+    if (entry->getParent() != F)
+      continue;
+
+    // The slow path consists of all blocks reachable from its entry without
+    // passing through the exit.
+    SmallVector<BasicBlock *, 8> region;
+    SmallPtrSet<BasicBlock *, 8> visited{exit};
+    SmallVector<BasicBlock *, 8> worklist{entry};
+    size_t numInstructions = 0;
+    while (!worklist.empty()) {
+      auto *block = worklist.pop_back_val();
+      if (!visited.insert(block).second)
+        continue;
+
+      region.push_back(block);
+      numInstructions += block->size();
+      for (auto *successor : successors(block))
+        worklist.push_back(successor);
+    }
+
+    if (numInstructions < kMinOutlinedSlowPathInstructions)
+      continue;
+
+    CodeExtractor extractor(region);
+    if (!extractor.isEligible())
+      continue;
+
+    auto *outlined = extractor.extractCodeRegion(analysisCache);
+    if (outlined == nullptr)
+      continue;
+
+    outlined->setName(kSlowPathPrefix + F->getName());
+    outlined->addFnAttr(Attribute::Cold);
+    outlined->addFnAttr(Attribute::NoInline);
+  }
+#else
+  // Before LLVM 11, CodeExtractor doesn't create debug info for the outlined
+  // functions, so the result would be invalid in debug builds.
+#endif
+}
+
 void Symbolizer::handleIntrinsicCall(CallBase &I) {
   auto *callee = I.getCalledFunction();
 
+  if (I.getType()->isVectorTy() ||
+      std::any_of(I.arg_begin(), I.arg_end(), [](Value *arg) {
+        return arg->getType()->isVectorTy();
+      })) {
+    handleVectorIntrinsicCall(I);
+    return;
+  }
+
   switch (callee->getIntrinsicID()) {
   case Intrinsic::dbg_value:
   case Intrinsic::is_constant:
@@ -344,6 +847,134 @@ void Symbolizer::handleIntrinsicCall(CallBase &I) {
   }
 }
 
+void Symbolizer::handleVectorIntrinsicCall(CallBase &I) {
+  auto *callee = I.getCalledFunction();
+
+  // Most intrinsics that we support on scalars work lane by lane on vectors.
+  auto buildLanewiseCall = [&](SymFnT function,
+                               ArrayRef<Value *> operands) {
+    buildLanewiseComputation(
+        I, operands,
+        [&](IRBuilder<> &IRB, unsigned /* lane */, ArrayRef<Value *> laneExprs)
+            -> Value * { return IRB.CreateCall(function, laneExprs); });
+  };
+
+  switch (callee->getIntrinsicID()) {
+  case Intrinsic::expect:
+    if (auto *expr = getSymbolicExpression(I.getArgOperand(0)))
+      symbolicExpressions[&I] = expr;
+    break;
+  case Intrinsic::fabs:
+    buildLanewiseCall(runtime.buildFloatAbs, I.getOperand(0));
+    break;
+  case Intrinsic::bswap:
+    buildLanewiseCall(runtime.buildBswap, I.getOperand(0));
+    break;
+  case Intrinsic::sadd_sat:
+    buildLanewiseCall(runtime.buildSAddSat, {I.getOperand(0), I.getOperand(1)});
+    break;
+  case Intrinsic::uadd_sat:
+    buildLanewiseCall(runtime.buildUAddSat, {I.getOperand(0), I.getOperand(1)});
+    break;
+  case Intrinsic::ssub_sat:
+    buildLanewiseCall(runtime.buildSSubSat, {I.getOperand(0), I.getOperand(1)});
+    break;
+  case Intrinsic::usub_sat:
+    buildLanewiseCall(runtime.buildUSubSat, {I.getOperand(0), I.getOperand(1)});
+    break;
+#if LLVM_VERSION_MAJOR > 11
+  case Intrinsic::sshl_sat:
+    buildLanewiseCall(runtime.buildSShlSat, {I.getOperand(0), I.getOperand(1)});
+    break;
+  case Intrinsic::ushl_sat:
+    buildLanewiseCall(runtime.buildUShlSat, {I.getOperand(0), I.getOperand(1)});
+    break;
+  case Intrinsic::abs:
+    buildLanewiseCall(runtime.buildAbs, I.getOperand(0));
+    break;
+#endif
+  case Intrinsic::fshl:
+  case Intrinsic::fshr:
+    buildLanewiseCall(I.getIntrinsicID() == Intrinsic::fshl ? runtime.buildFshl
+                                                            : runtime.buildFshr,
+                      {I.getOperand(0), I.getOperand(1), I.getOperand(2)});
+    break;
+
+// Integer reductions, which the vectorizer emits at the end of loops
+#if LLVM_VERSION_MAJOR > 11
+#define REDUCTION(op) Intrinsic::vector_reduce_##op
+#else
+#define REDUCTION(op) Intrinsic::experimental_vector_reduce_##op
+#endif
+  case REDUCTION(add):
+  case REDUCTION(mul):
+  case REDUCTION(and):
+  case REDUCTION(or):
+  case REDUCTION(xor): {
+    auto *vector = I.getArgOperand(0);
+    auto *vectorExpr = getSymbolicExpression(vector);
+    if (vectorExpr == nullptr)
+      break;
+
+    auto numLanes = getNumLanes(vector->getType());
+    if (numLanes == 0) {
+      errs() << "Warning: unhandled reduction of scalable vector " << I
+             << "; the result will be concretized\n";
+      break;
+    }
+
+    // Boolean lanes need the dedicated runtime functions (see
+    // visitBinaryOperator); addition and multiplication of single bits are
+    // the same as exclusive or and conjunction, respectively.
+    bool isBoolean = I.getType()->isIntegerTy(1);
+    SymFnT handler;
+    switch (callee->getIntrinsicID()) {
+    case REDUCTION(add):
+      handler = isBoolean ? runtime.buildBoolXor
+                          : runtime.binaryOperatorHandlers[Instruction::Add];
+      break;
+    case REDUCTION(mul):
+      handler = isBoolean ? runtime.buildBoolAnd
+                          : runtime.binaryOperatorHandlers[Instruction::Mul];
+      break;
+    case REDUCTION(and):
+      handler = isBoolean ? runtime.buildBoolAnd
+                          : runtime.binaryOperatorHandlers[Instruction::And];
+      break;
+    case REDUCTION(or):
+      handler = isBoolean ? runtime.buildBoolOr
+                          : runtime.binaryOperatorHandlers[Instruction::Or];
+      break;
+    default:
+      handler = isBoolean ? runtime.buildBoolXor
+                          : runtime.binaryOperatorHandlers[Instruction::Xor];
+      break;
+    }
+
+    IRBuilder<> IRB(&I);
+    auto *previous = I.getPrevNode();
+    Value *result = nullptr;
+    for (unsigned lane = 0; lane < numLanes; lane++) {
+      auto *laneExpr = convertLaneFromBits(
+          IRB,
+          extractLaneBits(IRB, vectorExpr, vector->getType(),
+                          IRB.getInt32(lane)),
+          I.getType());
+      result = result ? IRB.CreateCall(handler, {result, laneExpr}) : laneExpr;
+    }
+
+    registerVectorComputation(I, previous, result, vector);
+    break;
+  }
+#undef REDUCTION
+
+  default:
+    errs() << "Warning: unhandled LLVM vector intrinsic " << callee->getName()
+           << "; the result will be concretized\n";
+    break;
+  }
+}
+
 void Symbolizer::handleInlineAssembly(CallInst &I) {
   if (I.getType()->isVoidTy()) {
     errs() << "Warning: skipping over inline assembly " << I << '\n';
@@ -361,18 +992,50 @@ void Symbolizer::handleFunctionCall(CallBase &I, Instruction *returnPoint) {
     return;
   }
 
+  // Calls and returns share a site so that the runtime can match them.
+  auto callSite = addSite(&I, SiteKind::Call);
   IRBuilder<> IRB(returnPoint);
-  IRB.CreateCall(runtime.notifyRet, getTargetPreferredInt(&I));
+  IRB.CreateCall(runtime.notifyRet, getSiteId(callSite));
   IRB.SetInsertPoint(&I);
-  IRB.CreateCall(runtime.notifyCall, getTargetPreferredInt(&I));
+  IRB.CreateCall(runtime.notifyCall, getSiteId(callSite));
 
   if (callee == nullptr)
     tryAlternative(IRB, I.getCalledOperand());
 
-  for (Use &arg : I.args())
-    IRB.CreateCall(runtime.setParameterExpression,
-                   {ConstantInt::get(IRB.getInt8Ty(), arg.getOperandNo()),
-                    getSymbolicExpressionOrNull(arg)});
+  // Publish the argument expressions (see the function-call helpers in
+  // RuntimeCommon.h). Arguments that are concrete at compile time don't cost
+  // anything; for the others, we store the expression and set the argument's
+  // bit in the mask if the expression is non-null.
+  auto *maskType = IRB.getIntNTy(kArgumentMaskBits);
+  auto *slotsType = ArrayType::get(IRB.getInt8PtrTy(), kMaxFunctionArguments);
+  Value *mask = ConstantInt::get(maskType, 0);
+  for (Use &arg : I.args()) {
+    // There are no slots for the remaining arguments, so the callee treats
+    // them as concrete.
+    auto argNo = arg.getOperandNo();
+    if (argNo >= kMaxFunctionArguments)
+      break;
+
+    auto *expr = getSymbolicExpression(arg);
+
+    // The last bit of the mask covers all remaining arguments, so their slots
+    // must always be valid.
+    bool sharedBit = (argNo >= kArgumentMaskBits - 1);
+    if (expr == nullptr && !sharedBit)
+      continue;
+
+    auto *slot = IRB.CreateConstInBoundsGEP2_64(
+        slotsType, runtime.argumentExpressions, 0, argNo);
+    IRB.CreateStore(getSymbolicExpressionOrNull(arg), slot);
+    if (expr == nullptr)
+      continue;
+
+    auto *isSymbolic = IRB.CreateZExt(IRB.CreateIsNotNull(expr), maskType);
+    mask = IRB.CreateOr(
+        mask,
+        IRB.CreateShl(isSymbolic, std::min(argNo, kArgumentMaskBits - 1)));
+  }
+  IRB.CreateStore(mask, runtime.argumentMask);
 
   if (!I.user_empty()) {
     // The result of the function is used somewhere later on. Since we have no
@@ -383,10 +1046,31 @@ void Symbolizer::handleFunctionCall(CallBase &I, Instruction *returnPoint) {
     // order to avoid accidentally using whatever is stored there from the
     // previous function call. (If the function is instrumented, it will just
     // override our null with the real expression.)
-    IRB.CreateCall(runtime.setReturnExpression,
-                   ConstantPointerNull::get(IRB.getInt8PtrTy()));
+    auto *nullExpression = ConstantPointerNull::get(IRB.getInt8PtrTy());
+    IRB.CreateStore(nullExpression, runtime.returnExpression);
     IRB.SetInsertPoint(returnPoint);
-    symbolicExpressions[&I] = IRB.CreateCall(runtime.getReturnExpression);
+    symbolicExpressions[&I] =
+        IRB.CreateLoad(IRB.getInt8PtrTy(), runtime.returnExpression);
+    IRB.CreateStore(nullExpression, runtime.returnExpression);
+
+    // The runtime may be configured to concretize the results of some
+    // functions (see SYMCC_CONCRETIZE_POLICY in docs/Configuration.txt). We
+    // only give it the chance for integer and pointer results, whose concrete
+    // values it can use to pin the expression.
+    auto *returnType = I.getType();
+    if (returnType->isPointerTy() ||
+        (returnType->isIntegerTy() && returnType->getIntegerBitWidth() > 1 &&
+         returnType->getIntegerBitWidth() <= 64)) {
+      auto *value = returnType->isPointerTy()
+                        ? IRB.CreatePtrToInt(&I, IRB.getInt64Ty())
+                        : IRB.CreateZExt(&I, IRB.getInt64Ty());
+      registerSymbolicComputation(
+          buildRuntimeCall(IRB, runtime.concretizeReturn,
+                           {{getSiteId(callSite), false},
+                            {&I, true},
+                            {value, false}}),
+          &I);
+    }
   }
 }
 
@@ -398,7 +1082,7 @@ void Symbolizer::visitBinaryOperator(BinaryOperator &I) {
 
   // Special case: the run-time library distinguishes between "and" and "or"
   // on Boolean values and bit vectors.
-  if (I.getOperand(0)->getType() == IRB.getInt1Ty()) {
+  if (I.getType()->getScalarType() == IRB.getInt1Ty()) {
     switch (I.getOpcode()) {
     case Instruction::And:
       handler = runtime.buildBoolAnd;
@@ -417,6 +1101,14 @@ void Symbolizer::visitBinaryOperator(BinaryOperator &I) {
   }
 
   assert(handler && "Unable to handle binary operator");
+  if (I.getType()->isVectorTy()) {
+    buildLanewiseComputation(
+        I, {I.getOperand(0), I.getOperand(1)},
+        [&](IRBuilder<> &IRB, unsigned /* lane */, ArrayRef<Value *> laneExprs)
+            -> Value * { return IRB.CreateCall(handler, laneExprs); });
+    return;
+  }
+
   auto runtimeCall =
       buildRuntimeCall(IRB, handler, {I.getOperand(0), I.getOperand(1)});
   registerSymbolicComputation(runtimeCall, &I);
@@ -427,6 +1119,14 @@ void Symbolizer::visitUnaryOperator(UnaryOperator &I) {
   SymFnT handler = runtime.unaryOperatorHandlers.at(I.getOpcode());
 
   assert(handler && "Unable to handle unary operator");
+  if (I.getType()->isVectorTy()) {
+    buildLanewiseComputation(
+        I, I.getOperand(0),
+        [&](IRBuilder<> &IRB, unsigned /* lane */, ArrayRef<Value *> laneExprs)
+            -> Value * { return IRB.CreateCall(handler, laneExprs); });
+    return;
+  }
+
   auto runtimeCall = buildRuntimeCall(IRB, handler, I.getOperand(0));
   registerSymbolicComputation(runtimeCall, &I);
 }
@@ -436,11 +1136,31 @@ void Symbolizer::visitSelectInst(SelectInst &I) {
   // negated) condition to the path constraints and copy the symbolic
   // expression over from the chosen argument.
 
+  if (I.getCondition()->getType()->isVectorTy()) {
+    // With a vector condition, the choice is made for each lane separately.
+    auto *condition = I.getCondition();
+    bool symbolicCondition = (getSymbolicExpression(condition) != nullptr);
+    auto site = addSite(&I, SiteKind::Branch);
+    buildLanewiseComputation(
+        I, {condition, I.getTrueValue(), I.getFalseValue()},
+        [&](IRBuilder<> &IRB, unsigned lane,
+            ArrayRef<Value *> laneExprs) -> Value * {
+          auto *laneCondition = IRB.CreateExtractElement(condition, lane);
+          if (symbolicCondition) {
+            IRB.CreateCall(runtime.pushPathConstraint,
+                           {laneExprs[0], laneCondition, getSiteId(site)});
+          }
+          return IRB.CreateSelect(laneCondition, laneExprs[1], laneExprs[2]);
+        });
+    return;
+  }
+
   IRBuilder<> IRB(&I);
   auto runtimeCall = buildRuntimeCall(IRB, runtime.pushPathConstraint,
                                       {{I.getCondition(), true},
                                        {I.getCondition(), false},
-                                       {getTargetPreferredInt(&I), false}});
+                                       {createSiteId(&I, SiteKind::Branch),
+                                        false}});
   registerSymbolicComputation(runtimeCall);
   if (getSymbolicExpression(I.getTrueValue()) ||
       getSymbolicExpression(I.getFalseValue())) {
@@ -458,6 +1178,14 @@ void Symbolizer::visitCmpInst(CmpInst &I) {
   IRBuilder<> IRB(&I);
   SymFnT handler = runtime.comparisonHandlers.at(I.getPredicate());
   assert(handler && "Unable to handle icmp/fcmp variant");
+  if (I.getType()->isVectorTy()) {
+    buildLanewiseComputation(
+        I, {I.getOperand(0), I.getOperand(1)},
+        [&](IRBuilder<> &IRB, unsigned /* lane */, ArrayRef<Value *> laneExprs)
+            -> Value * { return IRB.CreateCall(handler, laneExprs); });
+    return;
+  }
+
   auto runtimeCall =
       buildRuntimeCall(IRB, handler, {I.getOperand(0), I.getOperand(1)});
   registerSymbolicComputation(runtimeCall, &I);
@@ -469,13 +1197,12 @@ void Symbolizer::visitReturnInst(ReturnInst &I) {
   if (I.getReturnValue() == nullptr)
     return;
 
-  // We can't short-circuit this call because the return expression needs to
-  // be set even if it's null; otherwise we break the caller. Therefore,
-  // create the call directly without registering it for short-circuit
-  // processing.
+  // The return expression needs to be set even if it's null; otherwise we
+  // break the caller. Therefore, store it directly without registering the
+  // computation for short-circuit processing.
   IRBuilder<> IRB(&I);
-  IRB.CreateCall(runtime.setReturnExpression,
-                 getSymbolicExpressionOrNull(I.getReturnValue()));
+  IRB.CreateStore(getSymbolicExpressionOrNull(I.getReturnValue()),
+                  runtime.returnExpression);
 }
 
 void Symbolizer::visitBranchInst(BranchInst &I) {
@@ -490,7 +1217,8 @@ void Symbolizer::visitBranchInst(BranchInst &I) {
   auto runtimeCall = buildRuntimeCall(IRB, runtime.pushPathConstraint,
                                       {{I.getCondition(), true},
                                        {I.getCondition(), false},
-                                       {getTargetPreferredInt(&I), false}});
+                                       {createSiteId(&I, SiteKind::Branch),
+                                        false}});
   registerSymbolicComputation(runtimeCall);
 }
 
@@ -524,17 +1252,57 @@ void Symbolizer::visitAllocaInst(AllocaInst & /*unused*/) {
 }
 
 void Symbolizer::visitLoadInst(LoadInst &I) {
+  // If an earlier load read the same shadow, we reuse its expression (and
+  // the address has been checked for alternatives already). We may not have
+  // processed the earlier load yet if it comes later in the function's block
+  // list, though.
+  if (auto *earlier = redundantLoads.lookup(&I)) {
+    if (auto *expr = symbolicExpressions.lookup(earlier)) {
+      symbolicExpressions[&I] = expr;
+      return;
+    }
+  }
+
   IRBuilder<> IRB(&I);
 
   auto *addr = I.getPointerOperand();
   tryAlternative(IRB, addr);
 
+  // In a run of adjacent loads, the first one reads the shadow for all of
+  // them.
+  if (auto *group = getAccessGroup(I)) {
+    if (group->front() == &I)
+      readAccessGroup(IRB, *group);
+    return;
+  }
+
   auto *dataType = I.getType();
-  auto *data = IRB.CreateCall(
-      runtime.readMemory,
-      {IRB.CreatePtrToInt(addr, intPtrType),
-       ConstantInt::get(intPtrType, dataLayout.getTypeStoreSize(dataType)),
-       IRB.getInt1(isLittleEndian(dataType) ? 1 : 0)});
+  uint64_t dataSize = dataLayout.getTypeStoreSize(dataType);
+  auto readMemory = [&](IRBuilder<> &IRB) {
+    return IRB.CreateCall(runtime.readMemory,
+                          {IRB.CreatePtrToInt(addr, intPtrType),
+                           ConstantInt::get(intPtrType, dataSize),
+                           IRB.getInt1(isLittleEndian(dataType) ? 1 : 0)});
+  };
+
+  Instruction *data;
+  if (canCheckShadowSummary(dataSize)) {
+    // Most memory doesn't have a shadow, so we look up the shadow summary
+    // inline and only call the runtime if the memory may be symbolic.
+    auto *head = I.getParent();
+    auto *slowPath = SplitBlockAndInsertIfThen(
+        createShadowSummaryCheck(IRB, addr), &I, /* unreachable */ false);
+    IRB.SetInsertPoint(slowPath);
+    auto *symbolicData = readMemory(IRB);
+
+    IRB.SetInsertPoint(&I);
+    auto *dataPHI = IRB.CreatePHI(IRB.getInt8PtrTy(), 2);
+    dataPHI->addIncoming(ConstantPointerNull::get(IRB.getInt8PtrTy()), head);
+    dataPHI->addIncoming(symbolicData, symbolicData->getParent());
+    data = dataPHI;
+  } else {
+    data = readMemory(IRB);
+  }
 
   symbolicExpressions[&I] = convertBitVectorExprForType(IRB, data, dataType);
 }
@@ -542,23 +1310,136 @@ void Symbolizer::visitLoadInst(LoadInst &I) {
 void Symbolizer::visitStoreInst(StoreInst &I) {
   IRBuilder<> IRB(&I);
 
-  tryAlternative(IRB, I.getPointerOperand());
+  auto *addr = I.getPointerOperand();
+  tryAlternative(IRB, addr);
+
+  // In a run of adjacent stores, the last one writes the shadow for all of
+  // them.
+  if (auto *group = getAccessGroup(I)) {
+    if (group->back() == &I)
+      writeAccessGroup(IRB, *group);
+    return;
+  }
+
+  auto V = I.getValueOperand();
+  auto *dataExpr = buildStoredExpression(IRB, V);
+  uint64_t dataSize = dataLayout.getTypeStoreSize(V->getType());
+
+  if (canCheckShadowSummary(dataSize)) {
+    // Storing a concrete value to memory without a shadow doesn't change the
+    // shadow, so we only call the runtime if either may be symbolic.
+    auto *mayBeSymbolic = IRB.CreateOr(IRB.CreateIsNotNull(dataExpr),
+                                       createShadowSummaryCheck(IRB, addr));
+    IRB.SetInsertPoint(SplitBlockAndInsertIfThen(mayBeSymbolic, &I,
+                                                 /* unreachable */ false));
+  }
+
+  IRB.CreateCall(runtime.writeMemory,
+                 {IRB.CreatePtrToInt(addr, intPtrType),
+                  ConstantInt::get(intPtrType, dataSize), dataExpr,
+                  IRB.getInt1(isLittleEndian(V->getType()) ? 1 : 0)});
+}
 
+Value *Symbolizer::buildStoredExpression(IRBuilder<> &IRB, Value *V) {
   // Make sure that the expression corresponding to the stored value is of
   // bit-vector kind. Shortcutting the runtime calls that we emit here (e.g.,
   // for floating-point values) is tricky, so instead we make sure that any
   // runtime function we call can handle null expressions.
-
-  auto V = I.getValueOperand();
   auto maybeConversion = convertExprForTypeToBitVectorExpr(IRB, V);
+  return maybeConversion ? maybeConversion->lastInstruction
+                         : getSymbolicExpressionOrNull(V);
+}
 
-  IRB.CreateCall(
-      runtime.writeMemory,
-      {IRB.CreatePtrToInt(I.getPointerOperand(), intPtrType),
-       ConstantInt::get(intPtrType, dataLayout.getTypeStoreSize(V->getType())),
-       maybeConversion ? maybeConversion->lastInstruction
-                       : getSymbolicExpressionOrNull(V),
-       IRB.getInt1(isLittleEndian(V->getType()) ? 1 : 0)});
+std::pair<Value *, Value *>
+Symbolizer::getAccessGroupBuffers(IRBuilder<> &IRB,
+                                  ArrayRef<Instruction *> group) {
+  if (accessGroupExpressions == nullptr) {
+    auto &entry = IRB.GetInsertBlock()->getParent()->getEntryBlock();
+    IRBuilder<> entryIRB(&*entry.getFirstInsertionPt());
+    accessGroupExpressions = entryIRB.CreateAlloca(
+        ArrayType::get(IRB.getInt8PtrTy(), kMaxAccessGroupSize));
+  }
+
+  SmallVector<Constant *, 4> lengths;
+  for (auto *access : group) {
+    lengths.push_back(ConstantInt::get(
+        intPtrType, dataLayout.getTypeStoreSize(getAccessedType(access))));
+  }
+  auto *lengthsType = ArrayType::get(intPtrType, lengths.size());
+  auto *lengthsTable = new GlobalVariable(
+      module, lengthsType, /* isConstant */ true, GlobalValue::PrivateLinkage,
+      ConstantArray::get(lengthsType, lengths), "__sym_access_lengths");
+  lengthsTable->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+
+  return {IRB.CreateConstInBoundsGEP2_32(lengthsType, lengthsTable, 0, 0),
+          IRB.CreateConstInBoundsGEP2_32(
+              accessGroupExpressions->getAllocatedType(),
+              accessGroupExpressions, 0, 0)};
+}
+
+void Symbolizer::readAccessGroup(IRBuilder<> &IRB,
+                                 ArrayRef<Instruction *> group) {
+  auto *first = group.front();
+  auto *addr = cast<LoadInst>(first)->getPointerOperand();
+  auto [lengths, exprs] = getAccessGroupBuffers(IRB, group);
+
+  // As for individual loads, we only call the runtime if the shadow summary
+  // says that the memory may be symbolic.
+  auto *head = first->getParent();
+  auto *slowPath = SplitBlockAndInsertIfThen(
+      createShadowSummaryCheck(IRB, addr), first, /* unreachable */ false);
+  IRB.SetInsertPoint(slowPath);
+  IRB.CreateCall(runtime.readMemoryMulti,
+                 {IRB.CreatePtrToInt(addr, intPtrType),
+                  ConstantInt::get(intPtrType, group.size()), lengths, exprs,
+                  IRB.getInt1(isLittleEndian(first->getType()) ? 1 : 0)});
+  SmallVector<Value *, 4> symbolicData;
+  for (unsigned i = 0; i < group.size(); i++) {
+    symbolicData.push_back(IRB.CreateLoad(
+        IRB.getInt8PtrTy(),
+        IRB.CreateConstInBoundsGEP1_32(IRB.getInt8PtrTy(), exprs, i)));
+  }
+
+  IRB.SetInsertPoint(first);
+  for (unsigned i = 0; i < group.size(); i++) {
+    auto *dataPHI = IRB.CreatePHI(IRB.getInt8PtrTy(), 2);
+    dataPHI->addIncoming(ConstantPointerNull::get(IRB.getInt8PtrTy()), head);
+    dataPHI->addIncoming(symbolicData[i], slowPath->getParent());
+    symbolicExpressions[group[i]] =
+        convertBitVectorExprForType(IRB, dataPHI, group[i]->getType());
+  }
+}
+
+void Symbolizer::writeAccessGroup(IRBuilder<> &IRB,
+                                  ArrayRef<Instruction *> group) {
+  auto *addr = cast<StoreInst>(group.front())->getPointerOperand();
+  SmallVector<Value *, 4> dataExprs;
+  for (auto *access : group) {
+    dataExprs.push_back(buildStoredExpression(
+        IRB, cast<StoreInst>(access)->getValueOperand()));
+  }
+
+  // We only need to update the shadow if some value or the memory may be
+  // symbolic (see visitStoreInst).
+  auto *mayBeSymbolic = createShadowSummaryCheck(IRB, addr);
+  for (auto *dataExpr : dataExprs) {
+    mayBeSymbolic =
+        IRB.CreateOr(mayBeSymbolic, IRB.CreateIsNotNull(dataExpr));
+  }
+  IRB.SetInsertPoint(SplitBlockAndInsertIfThen(
+      mayBeSymbolic, &*IRB.GetInsertPoint(), /* unreachable */ false));
+
+  auto [lengths, exprs] = getAccessGroupBuffers(IRB, group);
+  for (unsigned i = 0; i < group.size(); i++) {
+    IRB.CreateStore(dataExprs[i], IRB.CreateConstInBoundsGEP1_32(
+                                      IRB.getInt8PtrTy(), exprs, i));
+  }
+  IRB.CreateCall(runtime.writeMemoryMulti,
+                 {IRB.CreatePtrToInt(addr, intPtrType),
+                  ConstantInt::get(intPtrType, group.size()), lengths, exprs,
+                  IRB.getInt1(isLittleEndian(getAccessedType(group.front()))
+                                  ? 1
+                                  : 0)});
 }
 
 void Symbolizer::visitGetElementPtrInst(GetElementPtrInst &I) {
@@ -575,13 +1456,9 @@ void Symbolizer::visitGetElementPtrInst(GetElementPtrInst &I) {
     return;
   }
 
-  // If there are no indices or if they are all zero we can return early as
-  // well.
-  if (std::all_of(I.idx_begin(), I.idx_end(), [](Value *index) {
-        auto *ci = dyn_cast<ConstantInt>(index);
-        return (ci != nullptr && ci->isZero());
-      })) {
-    symbolicExpressions[&I] = getSymbolicExpression(I.getPointerOperand());
+  if (I.getType()->isVectorTy()) {
+    errs() << "Warning: unhandled vector GEP " << I
+           << "; the result will be concretized\n";
     return;
   }
 
@@ -589,10 +1466,13 @@ void Symbolizer::visitGetElementPtrInst(GetElementPtrInst &I) {
   SymbolicComputation symbolicComputation;
   Value *currentAddress = I.getPointerOperand();
 
+  // Constant indices don't need the solver: we add up their contributions at
+  // compile time and emit a single addition at the end.
+  APInt constantOffset(ptrBits, 0);
+
   for (auto type_it = gep_type_begin(I), type_end = gep_type_end(I);
        type_it != type_end; ++type_it) {
     auto *index = type_it.getOperand();
-    std::pair<Value *, bool> addressContribution;
 
     // There are two cases for the calculation:
     // 1. If the indexed type is a struct, we need to add the offset of the
@@ -604,56 +1484,75 @@ void Symbolizer::visitGetElementPtrInst(GetElementPtrInst &I) {
       // (https://llvm.org/docs/LangRef.html#getelementptr-instruction).
 
       unsigned memberIndex = cast<ConstantInt>(index)->getZExtValue();
-      unsigned memberOffset =
+      constantOffset +=
           dataLayout.getStructLayout(structType)->getElementOffset(memberIndex);
-      addressContribution = {ConstantInt::get(intPtrType, memberOffset), true};
-    } else {
-      if (auto *ci = dyn_cast<ConstantInt>(index);
-          ci != nullptr && ci->isZero()) {
-        // Fast path: an index of zero means that no calculations are
-        // performed.
-        continue;
-      }
+      continue;
+    }
 
-      // TODO optimize? If the index is constant, we can perform the
-      // multiplication ourselves instead of having the solver do it. Also, if
-      // the element size is 1, we can omit the multiplication.
+    uint64_t elementSize =
+        dataLayout.getTypeAllocSize(type_it.getIndexedType());
+    if (auto *ci = dyn_cast<ConstantInt>(index)) {
+      // Indices are signed.
+      constantOffset += ci->getValue().sextOrTrunc(ptrBits) * elementSize;
+      continue;
+    }
 
-      unsigned elementSize =
-          dataLayout.getTypeAllocSize(type_it.getIndexedType());
-      if (auto indexWidth = index->getType()->getIntegerBitWidth();
-          indexWidth != ptrBits) {
-        symbolicComputation.merge(forceBuildRuntimeCall(
-            IRB, runtime.buildZExt,
-            {{index, true},
-             {ConstantInt::get(IRB.getInt8Ty(), ptrBits - indexWidth),
-              false}}));
-        symbolicComputation.merge(forceBuildRuntimeCall(
-            IRB, runtime.binaryOperatorHandlers[Instruction::Mul],
-            {{symbolicComputation.lastInstruction, false},
-             {ConstantInt::get(intPtrType, elementSize), true}}));
-      } else {
-        symbolicComputation.merge(forceBuildRuntimeCall(
-            IRB, runtime.binaryOperatorHandlers[Instruction::Mul],
-            {{index, true},
-             {ConstantInt::get(intPtrType, elementSize), true}}));
-      }
+    std::pair<Value *, bool> elementOffset = {index, true};
+    if (auto indexWidth = index->getType()->getIntegerBitWidth();
+        indexWidth < ptrBits) {
+      symbolicComputation.merge(forceBuildRuntimeCall(
+          IRB, runtime.buildSExt,
+          {elementOffset,
+           {ConstantInt::get(IRB.getInt8Ty(), ptrBits - indexWidth), false}}));
+      elementOffset = {symbolicComputation.lastInstruction, false};
+    } else if (indexWidth > ptrBits) {
+      symbolicComputation.merge(forceBuildRuntimeCall(
+          IRB, runtime.buildTrunc,
+          {elementOffset,
+           {ConstantInt::get(IRB.getInt8Ty(), ptrBits), false}}));
+      elementOffset = {symbolicComputation.lastInstruction, false};
+    }
 
-      addressContribution = {symbolicComputation.lastInstruction, false};
+    // For byte-sized elements, the index is the offset already.
+    if (elementSize != 1) {
+      symbolicComputation.merge(forceBuildRuntimeCall(
+          IRB, runtime.binaryOperatorHandlers[Instruction::Mul],
+          {elementOffset,
+           {ConstantInt::get(intPtrType, elementSize), true}}));
+      elementOffset = {symbolicComputation.lastInstruction, false};
     }
 
     symbolicComputation.merge(forceBuildRuntimeCall(
         IRB, runtime.binaryOperatorHandlers[Instruction::Add],
-        {addressContribution,
+        {elementOffset,
          {currentAddress, (currentAddress == I.getPointerOperand())}}));
     currentAddress = symbolicComputation.lastInstruction;
   }
 
+  if (constantOffset != 0) {
+    symbolicComputation.merge(forceBuildRuntimeCall(
+        IRB, runtime.binaryOperatorHandlers[Instruction::Add],
+        {{ConstantInt::get(intPtrType, constantOffset), true},
+         {currentAddress, (currentAddress == I.getPointerOperand())}}));
+  }
+
+  // If all indices add up to zero, the result is just the base pointer.
+  if (symbolicComputation.firstInstruction == nullptr) {
+    symbolicExpressions[&I] = getSymbolicExpression(I.getPointerOperand());
+    return;
+  }
+
   registerSymbolicComputation(symbolicComputation, &I);
 }
 
 void Symbolizer::visitBitCastInst(BitCastInst &I) {
-  if (I.getSrcTy()->isIntegerTy() && I.getDestTy()->isFloatingPointTy()) {
+  // The expression of a vector is a bit vector, so vectors are converted like
+  // integers.
+  auto isBitVector = [](Type *type) {
+    return type->isIntegerTy() || type->isVectorTy();
+  };
+
+  if (isBitVector(I.getSrcTy()) && I.getDestTy()->isFloatingPointTy()) {
     IRBuilder<> IRB(&I);
     auto conversion =
         buildRuntimeCall(IRB, runtime.buildBitsToFloat,
@@ -663,21 +1562,27 @@ void Symbolizer::visitBitCastInst(BitCastInst &I) {
     return;
   }
 
-  if (I.getSrcTy()->isFloatingPointTy() && I.getDestTy()->isIntegerTy()) {
+  if (I.getSrcTy()->isFloatingPointTy() && isBitVector(I.getDestTy())) {
     IRBuilder<> IRB(&I);
     auto conversion = buildRuntimeCall(IRB, runtime.buildFloatToBits,
                                        {{I.getOperand(0), true}});
-    registerSymbolicComputation(conversion);
+    registerSymbolicComputation(conversion, &I);
     return;
   }
 
-  assert(I.getSrcTy()->isPointerTy() && I.getDestTy()->isPointerTy() &&
+  assert(((I.getSrcTy()->isPointerTy() && I.getDestTy()->isPointerTy()) ||
+          I.getSrcTy()->isVectorTy() || I.getDestTy()->isVectorTy()) &&
          "Unhandled non-pointer bit cast");
   if (auto *expr = getSymbolicExpression(I.getOperand(0)))
     symbolicExpressions[&I] = expr;
 }
 
 void Symbolizer::visitTruncInst(TruncInst &I) {
+  if (I.getType()->isVectorTy()) {
+    handleVectorCast(I);
+    return;
+  }
+
   IRBuilder<> IRB(&I);
 
   if (getSymbolicExpression(I.getOperand(0)) == nullptr)
@@ -713,6 +1618,11 @@ void Symbolizer::visitPtrToIntInst(PtrToIntInst &I) {
 }
 
 void Symbolizer::visitSIToFPInst(SIToFPInst &I) {
+  if (I.getType()->isVectorTy()) {
+    handleVectorCast(I);
+    return;
+  }
+
   IRBuilder<> IRB(&I);
   auto conversion =
       buildRuntimeCall(IRB, runtime.buildIntToFloat,
@@ -723,6 +1633,11 @@ void Symbolizer::visitSIToFPInst(SIToFPInst &I) {
 }
 
 void Symbolizer::visitUIToFPInst(UIToFPInst &I) {
+  if (I.getType()->isVectorTy()) {
+    handleVectorCast(I);
+    return;
+  }
+
   IRBuilder<> IRB(&I);
   auto conversion =
       buildRuntimeCall(IRB, runtime.buildIntToFloat,
@@ -733,6 +1648,11 @@ void Symbolizer::visitUIToFPInst(UIToFPInst &I) {
 }
 
 void Symbolizer::visitFPExtInst(FPExtInst &I) {
+  if (I.getType()->isVectorTy()) {
+    handleVectorCast(I);
+    return;
+  }
+
   IRBuilder<> IRB(&I);
   auto conversion =
       buildRuntimeCall(IRB, runtime.buildFloatToFloat,
@@ -742,6 +1662,11 @@ void Symbolizer::visitFPExtInst(FPExtInst &I) {
 }
 
 void Symbolizer::visitFPTruncInst(FPTruncInst &I) {
+  if (I.getType()->isVectorTy()) {
+    handleVectorCast(I);
+    return;
+  }
+
   IRBuilder<> IRB(&I);
   auto conversion =
       buildRuntimeCall(IRB, runtime.buildFloatToFloat,
@@ -751,6 +1676,11 @@ void Symbolizer::visitFPTruncInst(FPTruncInst &I) {
 }
 
 void Symbolizer::visitFPToSI(FPToSIInst &I) {
+  if (I.getType()->isVectorTy()) {
+    handleVectorCast(I);
+    return;
+  }
+
   IRBuilder<> IRB(&I);
   auto conversion = buildRuntimeCall(
       IRB, runtime.buildFloatToSignedInt,
@@ -760,6 +1690,11 @@ void Symbolizer::visitFPToSI(FPToSIInst &I) {
 }
 
 void Symbolizer::visitFPToUI(FPToUIInst &I) {
+  if (I.getType()->isVectorTy()) {
+    handleVectorCast(I);
+    return;
+  }
+
   IRBuilder<> IRB(&I);
   auto conversion = buildRuntimeCall(
       IRB, runtime.buildFloatToUnsignedInt,
@@ -775,6 +1710,11 @@ void Symbolizer::visitCastInst(CastInst &I) {
     return;
   }
 
+  if (I.getType()->isVectorTy()) {
+    handleVectorCast(I);
+    return;
+  }
+
   IRBuilder<> IRB(&I);
 
   SymFnT target;
@@ -817,6 +1757,66 @@ void Symbolizer::visitCastInst(CastInst &I) {
   }
 }
 
+void Symbolizer::handleVectorCast(CastInst &I) {
+  // The same as the scalar conversions above, applied to each lane.
+  auto *srcType = I.getSrcTy()->getScalarType();
+  auto *destType = I.getDestTy()->getScalarType();
+
+  buildLanewiseComputation(
+      I, I.getOperand(0),
+      [&](IRBuilder<> &IRB, unsigned /* lane */,
+          ArrayRef<Value *> laneExprs) -> Value * {
+        auto *laneExpr = laneExprs[0];
+        switch (I.getOpcode()) {
+        case Instruction::Trunc: {
+          auto *truncated = IRB.CreateCall(
+              runtime.buildTrunc,
+              {laneExpr, IRB.getInt8(destType->getIntegerBitWidth())});
+          if (destType->getIntegerBitWidth() == 1)
+            return IRB.CreateCall(runtime.buildBitToBool, {truncated});
+          return truncated;
+        }
+        case Instruction::SExt:
+        case Instruction::ZExt: {
+          auto target = (I.getOpcode() == Instruction::SExt)
+                            ? runtime.buildSExt
+                            : runtime.buildZExt;
+          if (srcType->getIntegerBitWidth() == 1) {
+            return IRB.CreateCall(
+                target,
+                {IRB.CreateCall(runtime.buildBoolToBit, {laneExpr}),
+                 IRB.getInt8(destType->getIntegerBitWidth() - 1)});
+          }
+          return IRB.CreateCall(target,
+                                {laneExpr,
+                                 IRB.getInt8(destType->getIntegerBitWidth() -
+                                             srcType->getIntegerBitWidth())});
+        }
+        case Instruction::SIToFP:
+        case Instruction::UIToFP:
+          return IRB.CreateCall(
+              runtime.buildIntToFloat,
+              {laneExpr, IRB.getInt1(destType->isDoubleTy()),
+               /* is_signed */
+               IRB.getInt1(I.getOpcode() == Instruction::SIToFP)});
+        case Instruction::FPExt:
+        case Instruction::FPTrunc:
+          return IRB.CreateCall(
+              runtime.buildFloatToFloat,
+              {laneExpr, IRB.getInt1(destType->isDoubleTy())});
+        case Instruction::FPToSI:
+        case Instruction::FPToUI:
+          return IRB.CreateCall(I.getOpcode() == Instruction::FPToSI
+                                    ? runtime.buildFloatToSignedInt
+                                    : runtime.buildFloatToUnsignedInt,
+                                {laneExpr,
+                                 IRB.getInt8(destType->getIntegerBitWidth())});
+        default:
+          llvm_unreachable("Unknown vector cast opcode");
+        }
+      });
+}
+
 void Symbolizer::visitPHINode(PHINode &I) {
   // PHI nodes just assign values based on the origin of the last jump, so we
   // assign the corresponding symbolic expression the same way.
@@ -894,6 +1894,149 @@ void Symbolizer::visitExtractValueInst(ExtractValueInst &I) {
       {extractedBits, result, {{target, 0, extractedBits}}}, &I);
 }
 
+void Symbolizer::visitExtractElementInst(ExtractElementInst &I) {
+  auto *vector = I.getVectorOperand();
+  auto *index = I.getIndexOperand();
+  auto *vectorExpr = getSymbolicExpression(vector);
+  if (vectorExpr == nullptr)
+    return;
+
+  auto numLanes = getNumLanes(vector->getType());
+  if (numLanes == 0) {
+    errs() << "Warning: unhandled scalable vector in " << I
+           << "; the result will be concretized\n";
+    return;
+  }
+
+  IRBuilder<> IRB(&I);
+  tryAlternative(IRB, index);
+
+  // Indices out of range produce poison, so we may use any lane in that case;
+  // we just need to stay within the vector expression.
+  auto *indexConstant = dyn_cast<ConstantInt>(index);
+  if (indexConstant != nullptr && indexConstant->getValue().uge(numLanes))
+    return;
+
+  auto *previous = I.getPrevNode();
+  auto *lane = (indexConstant != nullptr)
+                   ? index
+                   : IRB.CreateURem(
+                         index, ConstantInt::get(index->getType(), numLanes));
+  auto *laneExpr = convertLaneFromBits(
+      IRB, extractLaneBits(IRB, vectorExpr, vector->getType(), lane),
+      I.getType());
+  registerVectorComputation(I, previous, laneExpr, vector);
+}
+
+void Symbolizer::visitInsertElementInst(InsertElementInst &I) {
+  auto *vector = I.getOperand(0);
+  auto *element = I.getOperand(1);
+  auto *index = I.getOperand(2);
+  if (getSymbolicExpression(vector) == nullptr &&
+      getSymbolicExpression(element) == nullptr)
+    return;
+
+  auto numLanes = getNumLanes(I.getType());
+  if (numLanes == 0) {
+    errs() << "Warning: unhandled scalable vector in " << I
+           << "; the result will be concretized\n";
+    return;
+  }
+
+  IRBuilder<> IRB(&I);
+  tryAlternative(IRB, index);
+
+  // We assemble the result from the lanes of the original vector, replacing
+  // the lane at the index. If the index isn't constant, each lane needs a run
+  // time check.
+  auto *previous = I.getPrevNode();
+  Value *vectorExpr = nullptr;
+  auto *elementBits = convertLaneToBits(
+      IRB, getOperandExpression(IRB, element), element->getType());
+  std::vector<Value *> laneBits;
+  for (unsigned lane = 0; lane < numLanes; lane++) {
+    auto *isIndex =
+        IRB.CreateICmpEQ(index, ConstantInt::get(index->getType(), lane));
+    if (auto *isIndexConstant = dyn_cast<ConstantInt>(isIndex);
+        isIndexConstant != nullptr && isIndexConstant->isOne()) {
+      laneBits.push_back(elementBits);
+      continue;
+    }
+
+    if (vectorExpr == nullptr)
+      vectorExpr = getOperandExpression(IRB, vector);
+    auto *originalBits =
+        extractLaneBits(IRB, vectorExpr, I.getType(), IRB.getInt32(lane));
+    laneBits.push_back(isa<Constant>(isIndex)
+                           ? originalBits
+                           : IRB.CreateSelect(isIndex, elementBits,
+                                              originalBits));
+  }
+
+  registerVectorComputation(I, previous, concatLanes(IRB, laneBits),
+                            {vector, element});
+}
+
+void Symbolizer::visitShuffleVectorInst(ShuffleVectorInst &I) {
+  // Shufflevector assembles a vector from the lanes of two input vectors
+  // according to a constant mask
+  // (https://llvm.org/docs/LangRef.html#shufflevector-instruction).
+
+  auto *vectorType = I.getOperand(0)->getType();
+  auto numInputLanes = getNumLanes(vectorType);
+  if (numInputLanes == 0 || getNumLanes(I.getType()) == 0) {
+    errs() << "Warning: unhandled scalable vector in " << I
+           << "; the result will be concretized\n";
+    return;
+  }
+
+  SmallVector<int, 16> mask;
+  I.getShuffleMask(mask);
+
+  // Often, only one of the inputs is used; we mustn't build an expression for
+  // the other.
+  Value *inputs[] = {I.getOperand(0), I.getOperand(1)};
+  bool inputUsed[] = {false, false};
+  for (auto maskElement : mask) {
+    if (maskElement >= 0)
+      inputUsed[unsigned(maskElement) / numInputLanes] = true;
+  }
+  if ((!inputUsed[0] || getSymbolicExpression(inputs[0]) == nullptr) &&
+      (!inputUsed[1] || getSymbolicExpression(inputs[1]) == nullptr))
+    return;
+
+  IRBuilder<> IRB(&I);
+  auto *previous = I.getPrevNode();
+  Value *inputExprs[] = {nullptr, nullptr};
+  SmallVector<Value *, 2> usedInputs;
+  for (unsigned input = 0; input < 2; input++) {
+    if (inputUsed[input]) {
+      inputExprs[input] = getOperandExpression(IRB, inputs[input]);
+      usedInputs.push_back(inputs[input]);
+    }
+  }
+
+  auto *elementType = vectorType->getScalarType();
+  std::vector<Value *> laneBits;
+  for (auto maskElement : mask) {
+    if (maskElement < 0) {
+      // The lane is undefined; any value will do.
+      laneBits.push_back(convertLaneToBits(
+          IRB,
+          createValueExpression(Constant::getNullValue(elementType), IRB),
+          elementType));
+      continue;
+    }
+
+    laneBits.push_back(extractLaneBits(
+        IRB, inputExprs[unsigned(maskElement) / numInputLanes], vectorType,
+        IRB.getInt32(unsigned(maskElement) % numInputLanes)));
+  }
+
+  registerVectorComputation(I, previous, concatLanes(IRB, laneBits),
+                            usedInputs);
+}
+
 void Symbolizer::visitSwitchInst(SwitchInst &I) {
   // Switch compares a value against a set of integer constants; duplicate
   // constants are not allowed
@@ -913,13 +2056,14 @@ void Symbolizer::visitSwitchInst(SwitchInst &I) {
 
   // In the constraint block, we push one path constraint per case.
   IRB.SetInsertPoint(constraintBlock);
+  auto switchSite = addSite(&I, SiteKind::Branch);
   for (auto &caseHandle : I.cases()) {
     auto *caseTaken = IRB.CreateICmpEQ(condition, caseHandle.getCaseValue());
     auto *caseConstraint = IRB.CreateCall(
         runtime.comparisonHandlers[CmpInst::ICMP_EQ],
         {conditionExpr, createValueExpression(caseHandle.getCaseValue(), IRB)});
     IRB.CreateCall(runtime.pushPathConstraint,
-                   {caseConstraint, caseTaken, getTargetPreferredInt(&I)});
+                   {caseConstraint, caseTaken, getSiteId(switchSite)});
   }
 }
 
@@ -1053,6 +2197,38 @@ CallInst *Symbolizer::createValueExpression(Value *V, IRBuilder<> &IRB) {
     }
   }
 
+  if (valueType->isVectorTy()) {
+    // Vectors are bit vectors holding the lanes in memory order (see the
+    // comments on vector support in Symbolizer.h).
+    auto numLanes = getNumLanes(valueType);
+    assert(numLanes > 0 && "Scalable vectors are not supported");
+
+    if (isa<UndefValue>(V) &&
+        dataLayout.getTypeSizeInBits(valueType) ==
+            dataLayout.getTypeStoreSizeInBits(valueType)) {
+      // Like for structs, avoid iterating over undefined vectors.
+      return IRB.CreateCall(
+          runtime.buildZeroBytes,
+          {ConstantInt::get(intPtrType,
+                            dataLayout.getTypeStoreSize(valueType))});
+    }
+
+    auto *elementType = valueType->getScalarType();
+    auto *constantValue = dyn_cast<Constant>(V);
+    std::vector<Value *> laneBits;
+    for (unsigned lane = 0; lane < numLanes; lane++) {
+      Value *element = constantValue
+                           ? constantValue->getAggregateElement(lane)
+                           : nullptr;
+      if (element == nullptr)
+        element = IRB.CreateExtractElement(V, lane);
+      laneBits.push_back(convertLaneToBits(
+          IRB, createValueExpression(element, IRB), elementType));
+    }
+
+    return cast<CallInst>(concatLanes(IRB, laneBits));
+  }
+
   llvm_unreachable("Unhandled type for constant expression");
 }
 
@@ -1084,12 +2260,155 @@ void Symbolizer::tryAlternative(IRBuilder<> &IRB, Value *V) {
                        {destExpr, concreteDestExpr});
     auto *pushAssertion = IRB.CreateCall(
         runtime.pushPathConstraint,
-        {destAssertion, IRB.getInt1(true), getTargetPreferredInt(V)});
+        {destAssertion, IRB.getInt1(true),
+         createSiteId(&*IRB.GetInsertPoint(), SiteKind::Alternative)});
     registerSymbolicComputation(SymbolicComputation(
         concreteDestExpr, pushAssertion, {Input(V, 0, destAssertion)}));
   }
 }
 
+Value *Symbolizer::createShadowSummaryCheck(IRBuilder<> &IRB, Value *addr) {
+  auto *chunk = IRB.CreateLShr(IRB.CreatePtrToInt(addr, intPtrType),
+                               kShadowSummaryGranularityBits);
+  auto *index = IRB.CreateAnd(chunk, kShadowSummaryEntries - 1);
+  auto *summaryType = ArrayType::get(IRB.getInt8Ty(), kShadowSummaryEntries);
+  auto *entry = IRB.CreateLoad(
+      IRB.getInt8Ty(),
+      IRB.CreateInBoundsGEP(summaryType, runtime.shadowSummary,
+                            {ConstantInt::get(intPtrType, 0), index}));
+  return IRB.CreateICmpNE(entry, IRB.getInt8(0));
+}
+
+unsigned Symbolizer::addSite(Instruction *I, SiteKind kind) {
+  auto *int8PtrType = Type::getInt8PtrTy(module.getContext());
+  auto *int32Type = Type::getInt32Ty(module.getContext());
+
+  Constant *file = ConstantPointerNull::get(int8PtrType);
+  unsigned line = 0;
+  if (const auto &location = I->getDebugLoc()) {
+    file = getSiteString(location->getFilename());
+    line = location.getLine();
+  }
+
+  // Call sites name their callee, so that the runtime can apply per-function
+  // policies.
+  Constant *callee = ConstantPointerNull::get(int8PtrType);
+  if (kind == SiteKind::Call) {
+    if (auto *function = cast<CallBase>(I)->getCalledFunction())
+      callee = getSiteString(function->getName());
+  }
+
+  siteTable.push_back(ConstantStruct::getAnon(
+      {file, ConstantInt::get(int32Type, line),
+       ConstantInt::get(int32Type, static_cast<uint32_t>(kind)), callee}));
+  return siteTable.size() - 1;
+}
+
+Constant *Symbolizer::getSiteString(StringRef string) {
+  auto &stringConstant = siteStrings[string];
+  if (stringConstant == nullptr) {
+    auto *stringArray = ConstantDataArray::getString(
+        module.getContext(), string, /* AddNull */ true);
+    auto *stringGlobal = new GlobalVariable(
+        module, stringArray->getType(), /* isConstant */ true,
+        GlobalValue::PrivateLinkage, stringArray, "__sym_site_string");
+    stringGlobal->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+    stringConstant = ConstantExpr::getPointerCast(
+        stringGlobal, Type::getInt8PtrTy(module.getContext()));
+  }
+
+  return stringConstant;
+}
+
+ConstantInt *Symbolizer::getSiteId(unsigned siteIndex) {
+  // On 32-bit targets, very large modules may run out of indices; the
+  // remaining sites share the last one (and the runtime doesn't know them).
+  auto indexBits = ptrBits / 2;
+  auto maxIndex = (uint64_t(1) << indexBits) - 1;
+  auto index = std::min(firstSiteIndex + siteIndex, maxIndex);
+  return ConstantInt::get(intPtrType, getModuleSiteKey(module, indexBits) |
+                                          index);
+}
+
+uint64_t Symbolizer::getModuleSiteCount(const Module &M) {
+  auto *node = M.getNamedMetadata(kSiteCountMetadata);
+  if (node == nullptr || node->getNumOperands() == 0)
+    return 0;
+
+  return mdconst::extract<ConstantInt>(node->getOperand(0)->getOperand(0))
+      ->getZExtValue();
+}
+
+void Symbolizer::emitSiteTable() {
+  if (siteTable.empty())
+    return;
+
+  auto *tableType =
+      ArrayType::get(siteTable.front()->getType(), siteTable.size());
+  new GlobalVariable(module, tableType, /* isConstant */ true,
+                     GlobalValue::PrivateLinkage,
+                     ConstantArray::get(tableType, siteTable),
+                     kFunctionSiteTableName);
+
+  // Reserve the indices for the function's sites.
+  auto &context = module.getContext();
+  auto *count = ConstantAsMetadata::get(ConstantInt::get(
+      Type::getInt64Ty(context), firstSiteIndex + siteTable.size()));
+  auto *node = module.getOrInsertNamedMetadata(kSiteCountMetadata);
+  if (node->getNumOperands() == 0)
+    node->addOperand(MDTuple::get(context, {count}));
+  else
+    node->setOperand(0, MDTuple::get(context, {count}));
+}
+
+void Symbolizer::emitModuleSiteTable(Module &M, Function *ctor) {
+  if (auto *node = M.getNamedMetadata(kSiteCountMetadata))
+    M.eraseNamedMetadata(node);
+
+  // The functions' tables are in the order in which we created them, which is
+  // the order of their site indices.
+  SmallVector<GlobalVariable *, 0> functionTables;
+  for (auto &global : M.globals()) {
+    if (global.getName().startswith(kFunctionSiteTableName))
+      functionTables.push_back(&global);
+  }
+  if (functionTables.empty())
+    return;
+
+  std::vector<Constant *> entries;
+  for (auto *functionTable : functionTables) {
+    // Tables of null entries may be folded to zero initializers, so we can't
+    // simply take the operands.
+    auto *initializer = functionTable->getInitializer();
+    auto size = functionTable->getValueType()->getArrayNumElements();
+    for (uint64_t i = 0; i < size; i++)
+      entries.push_back(initializer->getAggregateElement(i));
+    functionTable->eraseFromParent();
+  }
+
+  auto *tableType = ArrayType::get(entries.front()->getType(), entries.size());
+  auto *table = new GlobalVariable(
+      M, tableType, /* isConstant */ true, GlobalValue::PrivateLinkage,
+      ConstantArray::get(tableType, entries), "__sym_sites");
+  // Collect all tables in one section so that tools can find them in the
+  // binary.
+  table->setSection("__sym_sites");
+
+  if (ctor == nullptr)
+    return;
+
+  Runtime runtime(M);
+  auto &dataLayout = M.getDataLayout();
+  auto *intPtrType = dataLayout.getIntPtrType(M.getContext());
+  auto indexBits = dataLayout.getPointerSizeInBits() / 2;
+  IRBuilder<> IRB(ctor->getEntryBlock().getTerminator());
+  IRB.CreateCall(
+      runtime.registerSites,
+      {ConstantInt::get(intPtrType, getModuleSiteKey(M, indexBits)),
+       IRB.CreateBitCast(table, IRB.getInt8PtrTy()),
+       ConstantInt::get(intPtrType, entries.size())});
+}
+
 uint64_t Symbolizer::aggregateMemberOffset(Type *aggregateType,
                                            ArrayRef<unsigned> indices) const {
   uint64_t offset = 0;
@@ -1125,6 +2444,13 @@ Instruction *Symbolizer::convertBitVectorExprForType(llvm::IRBuilder<> &IRB,
     result = IRB.CreateCall(runtime.buildTrunc,
                             {I, ConstantInt::get(IRB.getInt8Ty(), 1)});
     result = IRB.CreateCall(runtime.buildBitToBool, {result});
+  } else if (T->isVectorTy()) {
+    // Vectors of small elements may not fill their last byte (e.g., <4 x i1>).
+    auto bits = dataLayout.getTypeSizeInBits(T);
+    if (bits < dataLayout.getTypeStoreSizeInBits(T)) {
+      result = IRB.CreateCall(runtime.buildTrunc,
+                              {I, ConstantInt::get(IRB.getInt8Ty(), bits)});
+    }
   }
 
   return result;
@@ -1145,7 +2471,145 @@ Symbolizer::convertExprForTypeToBitVectorExpr(llvm::IRBuilder<> &IRB,
                                  {IRB.getInt8(7 /* 1 byte */), false}}));
       return computation;
     }
+  } else if (T->isVectorTy()) {
+    // See convertBitVectorExprForType.
+    auto bits = dataLayout.getTypeSizeInBits(T);
+    auto storeBits = dataLayout.getTypeStoreSizeInBits(T);
+    if (bits < storeBits) {
+      return buildRuntimeCall(
+          IRB, runtime.buildZExt,
+          {{V, true}, {IRB.getInt8(storeBits - bits), false}});
+    }
   }
 
   return {};
 }
+
+void Symbolizer::buildLanewiseComputation(
+    Instruction &I, ArrayRef<Value *> operands,
+    function_ref<Value *(IRBuilder<> &IRB, unsigned lane,
+                         ArrayRef<Value *> laneExprs)>
+        buildLane) {
+  if (std::all_of(operands.begin(), operands.end(), [this](Value *operand) {
+        return (getSymbolicExpression(operand) == nullptr);
+      }))
+    return;
+
+  auto numLanes = getNumLanes(I.getType());
+  if (numLanes == 0) {
+    errs() << "Warning: unhandled scalable vector in " << I
+           << "; the result will be concretized\n";
+    return;
+  }
+
+  IRBuilder<> IRB(&I);
+  auto *previous = I.getPrevNode();
+
+  SmallVector<Value *, 3> operandExprs;
+  for (auto *operand : operands)
+    operandExprs.push_back(getOperandExpression(IRB, operand));
+
+  auto *resultElementType = I.getType()->getScalarType();
+  std::vector<Value *> resultLanes;
+  SmallVector<Value *, 3> laneExprs(operands.size());
+  for (unsigned lane = 0; lane < numLanes; lane++) {
+    for (unsigned i = 0; i < operands.size(); i++) {
+      auto *operandType = operands[i]->getType();
+      laneExprs[i] = convertLaneFromBits(
+          IRB,
+          extractLaneBits(IRB, operandExprs[i], operandType,
+                          IRB.getInt32(lane)),
+          operandType->getScalarType());
+    }
+
+    resultLanes.push_back(convertLaneToBits(
+        IRB, buildLane(IRB, lane, laneExprs), resultElementType));
+  }
+
+  registerVectorComputation(I, previous, concatLanes(IRB, resultLanes),
+                            operands);
+}
+
+void Symbolizer::registerVectorComputation(Instruction &I,
+                                           Instruction *previous,
+                                           Value *result,
+                                           ArrayRef<Value *> operands) {
+  auto *first =
+      (previous != nullptr) ? previous->getNextNode() : &I.getParent()->front();
+  if (first == &I) {
+    // We haven't emitted any code because the result is the expression of an
+    // operand.
+    symbolicExpressions[&I] = result;
+    return;
+  }
+
+  SymbolicComputation computation(first, cast<Instruction>(result), {});
+  for (auto *inst = first; inst != &I; inst = inst->getNextNode()) {
+    for (auto &use : inst->operands()) {
+      auto *operand =
+          std::find_if(operands.begin(), operands.end(), [&](Value *operand) {
+            return (getSymbolicExpression(operand) == use.get());
+          });
+      if (operand != operands.end())
+        computation.inputs.push_back(Input(*operand, use.getOperandNo(), inst));
+    }
+  }
+
+  registerSymbolicComputation(computation, &I);
+}
+
+Value *Symbolizer::extractLaneBits(IRBuilder<> &IRB, Value *vectorExpr,
+                                   Type *vectorType, Value *lane) {
+  auto numLanes = getNumLanes(vectorType);
+  auto laneBits = dataLayout.getTypeSizeInBits(vectorType->getScalarType());
+
+  // Lane 0 is the least significant on little-endian targets and the most
+  // significant on big-endian ones.
+  lane = IRB.CreateZExtOrTrunc(lane, intPtrType);
+  auto *position =
+      dataLayout.isLittleEndian()
+          ? lane
+          : IRB.CreateSub(ConstantInt::get(intPtrType, numLanes - 1), lane);
+  auto *lowBit =
+      IRB.CreateMul(position, ConstantInt::get(intPtrType, laneBits));
+  auto *highBit =
+      IRB.CreateAdd(lowBit, ConstantInt::get(intPtrType, laneBits - 1));
+  return IRB.CreateCall(runtime.buildExtractBits,
+                        {vectorExpr, highBit, lowBit});
+}
+
+Value *Symbolizer::convertLaneFromBits(IRBuilder<> &IRB, Value *laneBits,
+                                       Type *elementType) {
+  if (elementType->isFloatingPointTy()) {
+    return IRB.CreateCall(runtime.buildBitsToFloat,
+                          {laneBits, IRB.getInt1(elementType->isDoubleTy())});
+  }
+
+  if (elementType->isIntegerTy(1))
+    return IRB.CreateCall(runtime.buildBitToBool, {laneBits});
+
+  return laneBits;
+}
+
+Value *Symbolizer::convertLaneToBits(IRBuilder<> &IRB, Value *laneExpr,
+                                     Type *elementType) {
+  if (elementType->isFloatingPointTy())
+    return IRB.CreateCall(runtime.buildFloatToBits, {laneExpr});
+
+  if (elementType->isIntegerTy(1))
+    return IRB.CreateCall(runtime.buildBoolToBit, {laneExpr});
+
+  return laneExpr;
+}
+
+Value *Symbolizer::concatLanes(IRBuilder<> &IRB, ArrayRef<Value *> laneBits) {
+  // See extractLaneBits for the order of the lanes.
+  Value *result = laneBits.front();
+  for (auto *bits : laneBits.drop_front()) {
+    result = dataLayout.isLittleEndian()
+                 ? IRB.CreateCall(runtime.buildConcat, {bits, result})
+                 : IRB.CreateCall(runtime.buildConcat, {result, bits});
+  }
+
+  return result;
+}
@@ -15,6 +15,11 @@
 #ifndef SYMBOLIZE_H
 #define SYMBOLIZE_H
 
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Analysis/AliasAnalysis.h>
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/InstVisitor.h>
@@ -26,14 +31,73 @@
 
 class Symbolizer : public llvm::InstVisitor<Symbolizer> {
 public:
+  /// The name prefix of the functions created by outlineSlowPaths.
+  static constexpr char kSlowPathPrefix[] = "__sym_slow_path.";
+
   explicit Symbolizer(llvm::Module &M)
-      : runtime(M), dataLayout(M.getDataLayout()),
+      : runtime(M), module(M), dataLayout(M.getDataLayout()),
         ptrBits(M.getDataLayout().getPointerSizeInBits()),
-        intPtrType(M.getDataLayout().getIntPtrType(M.getContext())) {}
+        intPtrType(M.getDataLayout().getIntPtrType(M.getContext())),
+        firstSiteIndex(getModuleSiteCount(M)) {}
 
   /// Insert code to obtain the symbolic expressions for the function arguments.
   void symbolizeFunctionArguments(llvm::Function &F);
 
+  /// Instrument a function whose computations we don't track.
+  ///
+  /// This is the lightweight alternative to full instrumentation for functions
+  /// excluded by the user (see SYMCC_INSTRUMENT_DENYLIST in
+  /// docs/Configuration.txt). The function only does the minimum to keep the
+  /// rest of the program consistent: its memory writes make the written bytes
+  /// concrete, it returns a null expression, and it clears the mask of
+  /// symbolic arguments before making calls, so that instrumented callees
+  /// don't pick up stale argument expressions.
+  void concretizeFunction(llvm::Function &F);
+
+  /// Find loads that are guaranteed to read the same shadow as an earlier
+  /// load.
+  ///
+  /// The shadow of a memory location only changes when the program writes to
+  /// it. So if a load reads the same address as a dominating load with the
+  /// same type, and alias analysis (via MemorySSA) rules out any write to the
+  /// location in between, the later load can reuse the expression of the
+  /// earlier one instead of calling the runtime again. Must be called before
+  /// the function is instrumented, because our own runtime calls would count
+  /// as writes.
+  void findRedundantLoads(llvm::Function &F, llvm::AAResults &AA);
+
+  /// Find runs of adjacent loads or stores that can share a shadow access.
+  ///
+  /// Struct copies and field-by-field initialization become sequences of loads
+  /// and stores to contiguous memory. Instead of checking the shadow for each
+  /// of them, we read the shadow for a run of loads at the first one and write
+  /// it for a run of stores at the last one, with a single check of the
+  /// shadow summary and at most one runtime call (see _sym_read_memory_multi
+  /// and _sym_write_memory_multi). A run only contains accesses within one
+  /// basic block, and alias analysis makes sure that moving the shadow
+  /// accesses doesn't reorder them with conflicting accesses in between. Like
+  /// findRedundantLoads, this must be called before instrumentation; call it
+  /// after findRedundantLoads, whose loads don't access the shadow at all.
+  void findAccessGroups(llvm::Function &F, llvm::AAResults &AA);
+
+  /// Find computations whose results only flow into calls to output functions.
+  ///
+  /// Values that are only printed or logged can't influence the program's
+  /// control flow or memory accesses, so there is no point in building their
+  /// expressions. A value qualifies if each of its uses is either an argument
+  /// of a call to one of the given sink functions or the operand of another
+  /// qualifying computation; anything else (e.g., a store, a branch, a select,
+  /// a return or a call to another function) may feed a branch. Only
+  /// instructions without side effects in the instrumentation are
+  /// considered, so that skipping them loses nothing but the expression.
+  void findSinkOnlyValues(llvm::Function &F, const llvm::StringSet<> &sinks);
+
+  /// Check whether an instruction's result only flows into output functions
+  /// (see findSinkOnlyValues), so that it doesn't need instrumentation.
+  bool isSinkOnly(llvm::Instruction &I) const {
+    return sinkOnlyValues.count(&I) > 0;
+  }
+
   /// Insert a call to the run-time library to notify it of the basic block
   /// entry.
   void insertBasicBlockNotification(llvm::BasicBlock &B);
@@ -93,11 +157,43 @@ public:
   ///
   /// The resulting code is much longer but avoids solver calls for all
   /// operations without symbolic data.
+  ///
+  /// Moreover, if an input expression is dead after the computation (see
+  /// findDeadInputs), the slow path releases it, so that the runtime can free
+  /// it right away instead of keeping it until garbage collection.
   void shortCircuitExpressionUses();
 
+  /// Move the slow paths created by shortCircuitExpressionUses out of line.
+  ///
+  /// Symbolic computation is rare at run time, but its code would otherwise
+  /// be interleaved with the concrete computation and bloat hot functions.
+  /// Therefore, we extract every slow path that is large enough into a
+  /// separate function marked cold and noinline, leaving only a call on the
+  /// (unlikely) symbolic branch. Must be called after
+  /// shortCircuitExpressionUses.
+  void outlineSlowPaths();
+
+  /// Emit the site table of the function.
+  ///
+  /// Each instrumented function gets a table describing its sites (i.e.,
+  /// basic blocks, branches, calls, etc.) with their source locations. The
+  /// sites of a module are numbered consecutively across functions, and
+  /// emitModuleSiteTable combines the functions' tables once all functions have
+  /// been instrumented.
+  void emitSiteTable();
+
+  /// Combine the site tables of all functions in the module into one, and
+  /// register it with the runtime from the given module constructor.
+  ///
+  /// Since we instrument one function at a time, this needs to run after the
+  /// last function (i.e., at the end of the pipeline).
+  static void emitModuleSiteTable(llvm::Module &M, llvm::Function *ctor);
+
   void handleIntrinsicCall(llvm::CallBase &I);
   void handleInlineAssembly(llvm::CallInst &I);
   void handleFunctionCall(llvm::CallBase &I, llvm::Instruction *returnPoint);
+  void handleVectorIntrinsicCall(llvm::CallBase &I);
+  void handleVectorCast(llvm::CastInst &I);
 
   //
   // Implementation of InstVisitor
@@ -129,14 +225,29 @@ public:
   void visitPHINode(llvm::PHINode &I);
   void visitInsertValueInst(llvm::InsertValueInst &I);
   void visitExtractValueInst(llvm::ExtractValueInst &I);
+  void visitExtractElementInst(llvm::ExtractElementInst &I);
+  void visitInsertElementInst(llvm::InsertElementInst &I);
+  void visitShuffleVectorInst(llvm::ShuffleVectorInst &I);
   void visitSwitchInst(llvm::SwitchInst &I);
   void visitUnreachableInst(llvm::UnreachableInst &);
   void visitInstruction(llvm::Instruction &I);
 
 private:
   static constexpr unsigned kExpectedMaxPHINodesPerFunction = 16;
+
+  /// The kinds of sites in the site table (see SymSiteKind in
+  /// runtime/RuntimeCommon.h).
+  enum class SiteKind : uint32_t { BasicBlock, Branch, Call, Alternative };
   static constexpr unsigned kExpectedSymbolicArgumentsPerComputation = 2;
 
+  /// The branch weight of the concrete path relative to the symbolic one when
+  /// short-circuiting a computation.
+  static constexpr uint32_t kConcretePathWeight = 2000;
+
+  /// The minimum number of instructions in a slow path for outlining to pay
+  /// off; smaller slow paths are hardly larger than the call replacing them.
+  static constexpr unsigned kMinOutlinedSlowPathInstructions = 8;
+
   /// A symbolic input.
   struct Input {
     llvm::Value *concreteValue;
@@ -201,6 +312,18 @@ private:
     }
   };
 
+  /// Find the inputs of each symbolic computation whose expressions are dead
+  /// afterwards, as indices into the computation's inputs.
+  ///
+  /// This is the case for an expression that a runtime builder has just handed
+  /// out (see _sym_release) if its only uses are in a single computation in
+  /// the same basic block, and none of them stores it anywhere (e.g., a value
+  /// that is computed only to be compared or printed). Must be called before
+  /// the computations are short-circuited.
+  std::vector<
+      llvm::SmallVector<unsigned, kExpectedSymbolicArgumentsPerComputation>>
+  findDeadInputs() const;
+
   /// Create an expression that represents the concrete value.
   llvm::CallInst *createValueExpression(llvm::Value *V, llvm::IRBuilder<> &IRB);
 
@@ -222,6 +345,18 @@ private:
     return (!type->isAggregateType() && dataLayout.isLittleEndian());
   }
 
+  /// Check whether a memory access of the given size can be guarded by the
+  /// shadow summary (see createShadowSummaryCheck).
+  static bool canCheckShadowSummary(uint64_t accessSize) {
+    return accessSize <= (uint64_t(1) << kShadowSummaryGranularityBits);
+  }
+
+  /// Emit an inline lookup in the runtime's shadow summary, producing true if
+  /// memory at the given address may have a shadow. If the result is false,
+  /// an access of up to one summary chunk at the address is entirely concrete.
+  llvm::Value *createShadowSummaryCheck(llvm::IRBuilder<> &IRB,
+                                        llvm::Value *addr);
+
   /// Like buildRuntimeCall, but the call is always generated.
   SymbolicComputation forceBuildRuntimeCall(
       llvm::IRBuilder<> &IRB, SymFnT function,
@@ -282,25 +417,30 @@ private:
   /// Generate code that makes the solver try an alternative value for V.
   void tryAlternative(llvm::IRBuilder<> &IRB, llvm::Value *V);
 
-  /// Helper to use a pointer to a host object as integer (truncating!).
-  ///
-  /// Note that the conversion will truncate the most significant bits of the
-  /// pointer if the host uses larger addresses than the target. Therefore, use
-  /// this function only when such loss is acceptable (e.g., when generating
-  /// site identifiers to be passed to the backend, where collisions of the
-  /// least significant bits are reasonably unlikely).
-  ///
-  /// Why not do a lossless conversion and make the backend accept 64-bit
-  /// integers?
+  /// Return the number of sites in the module's site table so far.
+  static uint64_t getModuleSiteCount(const llvm::Module &M);
+
+  /// Add a site to the function's site table and return its index.
   ///
-  /// 1. Performance: 32-bit architectures will process 32-bit values faster
-  /// than 64-bit values.
+  /// The source location of the site is taken from the debug information of
+  /// the given instruction, if available.
+  unsigned addSite(llvm::Instruction *I, SiteKind kind);
+
+  /// Return a pointer to a string constant for use in the site table.
+  llvm::Constant *getSiteString(llvm::StringRef string);
+
+  /// Return the run-time ID of the site with the given index.
   ///
-  /// 2. Pragmatism: Changing the backend to accept and process 64-bit values
-  /// would require modifying code that we don't control (in the case of Qsym).
-  llvm::ConstantInt *getTargetPreferredInt(void *pointer) {
-    return llvm::ConstantInt::get(intPtrType,
-                                  reinterpret_cast<uint64_t>(pointer));
+  /// Site IDs are constants (see _sym_register_sites in RuntimeCommon.h): a
+  /// hash of the module's source file name in the upper half, and the index of
+  /// the site in the module's table in the lower half. In contrast to the
+  /// addresses of LLVM objects, which we used to pass, the IDs are
+  /// deterministic across builds and dense within each module.
+  llvm::ConstantInt *getSiteId(unsigned siteIndex);
+
+  /// Convenience function combining addSite and getSiteId.
+  llvm::ConstantInt *createSiteId(llvm::Instruction *I, SiteKind kind) {
+    return getSiteId(addSite(I, kind));
   }
 
   /// Compute the offset of a member in a (possibly nested) aggregate.
@@ -328,8 +468,108 @@ private:
   convertExprForTypeToBitVectorExpr(llvm::IRBuilder<> &IRB,
                                     llvm::Value *V) const;
 
+  /// Return the expression to store in memory for the given value.
+  llvm::Value *buildStoredExpression(llvm::IRBuilder<> &IRB, llvm::Value *V);
+
+  /// Return the run of adjacent accesses that I belongs to, or null if I is
+  /// accessed on its own (see findAccessGroups).
+  const llvm::SmallVectorImpl<llvm::Instruction *> *
+  getAccessGroup(llvm::Instruction &I) const {
+    auto it = accessGroupIndices.find(&I);
+    return it == accessGroupIndices.end() ? nullptr
+                                          : &accessGroups[it->second];
+  }
+
+  /// Read the shadow for a run of adjacent loads, setting the expressions of
+  /// all of them.
+  void readAccessGroup(llvm::IRBuilder<> &IRB,
+                       llvm::ArrayRef<llvm::Instruction *> group);
+
+  /// Write the shadow for a run of adjacent stores.
+  void writeAccessGroup(llvm::IRBuilder<> &IRB,
+                        llvm::ArrayRef<llvm::Instruction *> group);
+
+  /// Emit the arguments describing the lengths and expressions of a run of
+  /// adjacent accesses for the runtime (see _sym_read_memory_multi).
+  std::pair<llvm::Value *, llvm::Value *>
+  getAccessGroupBuffers(llvm::IRBuilder<> &IRB,
+                        llvm::ArrayRef<llvm::Instruction *> group);
+
+  //
+  // Vector support
+  //
+  // The expression of a vector is a single bit vector holding the lanes in
+  // memory order: lane 0 occupies the least significant bits on little-endian
+  // targets and the most significant bits on big-endian ones, just like in the
+  // result of a bit cast to an integer. Floating-point and Boolean lanes are
+  // stored as bit vectors. This way, loads, stores and bit casts of vectors
+  // don't need any conversion, and we only look at individual lanes for
+  // computations.
+  //
+
+  /// Build the expression of a vector-valued instruction lane by lane.
+  ///
+  /// The callback emits the computation for one lane of the result; it
+  /// receives the expressions of the operands' lanes (converted for the
+  /// element type) and returns an expression appropriate for the result's
+  /// element type. All operands must be vectors with as many lanes as the
+  /// result.
+  void buildLanewiseComputation(
+      llvm::Instruction &I, llvm::ArrayRef<llvm::Value *> operands,
+      llvm::function_ref<llvm::Value *(llvm::IRBuilder<> &IRB, unsigned lane,
+                                       llvm::ArrayRef<llvm::Value *> laneExprs)>
+          buildLane);
+
+  /// Get the expression of an operand for use in a vector computation.
+  ///
+  /// Operands that are concrete at compile time don't have an expression, so
+  /// we build one from the concrete value; it will only be evaluated if the
+  /// computation isn't short-circuited.
+  llvm::Value *getOperandExpression(llvm::IRBuilder<> &IRB, llvm::Value *V) {
+    if (auto *expr = getSymbolicExpression(V))
+      return expr;
+    return createValueExpression(V, IRB);
+  }
+
+  /// Register the code emitted before I (after the given previous
+  /// instruction, which is null if I was at the start of its block) as the
+  /// symbolic computation of the vector instruction I, producing the given
+  /// result.
+  ///
+  /// Vector computations use the operands' expressions many times, so instead
+  /// of tracking each use while emitting code, we scan the emitted
+  /// instructions for uses of the operands' expressions and record them as
+  /// inputs.
+  void registerVectorComputation(llvm::Instruction &I,
+                                 llvm::Instruction *previous,
+                                 llvm::Value *result,
+                                 llvm::ArrayRef<llvm::Value *> operands);
+
+  /// Emit code that extracts the bit-vector expression of a vector lane. The
+  /// lane index doesn't need to be constant.
+  llvm::Value *extractLaneBits(llvm::IRBuilder<> &IRB, llvm::Value *vectorExpr,
+                               llvm::Type *vectorType, llvm::Value *lane);
+
+  /// Emit code that converts the bit-vector expression of a lane to an
+  /// expression appropriate for the element type.
+  llvm::Value *convertLaneFromBits(llvm::IRBuilder<> &IRB,
+                                   llvm::Value *laneBits,
+                                   llvm::Type *elementType);
+
+  /// The inverse of convertLaneFromBits.
+  llvm::Value *convertLaneToBits(llvm::IRBuilder<> &IRB, llvm::Value *laneExpr,
+                                 llvm::Type *elementType);
+
+  /// Emit code that concatenates the bit-vector expressions of all lanes of a
+  /// vector, in the order of the lanes.
+  llvm::Value *concatLanes(llvm::IRBuilder<> &IRB,
+                           llvm::ArrayRef<llvm::Value *> laneBits);
+
   const Runtime runtime;
 
+  /// The currently processed module.
+  llvm::Module &module;
+
   /// The data layout of the currently processed module.
   const llvm::DataLayout &dataLayout;
 
@@ -358,6 +598,26 @@ private:
   /// after all instructions have been processed.
   llvm::SmallVector<llvm::PHINode *, kExpectedMaxPHINodesPerFunction> phiNodes;
 
+  /// Loads that read the same shadow as an earlier load (see
+  /// findRedundantLoads), mapped to that load.
+  llvm::DenseMap<llvm::LoadInst *, llvm::LoadInst *> redundantLoads;
+
+  /// Instructions whose results only flow into output functions (see
+  /// findSinkOnlyValues).
+  llvm::DenseSet<llvm::Instruction *> sinkOnlyValues;
+
+  /// The maximum number of accesses in a run (see findAccessGroups).
+  static constexpr unsigned kMaxAccessGroupSize = 16;
+
+  /// Runs of adjacent loads or stores in address order (see
+  /// findAccessGroups), and the index of the run that each access belongs to.
+  std::vector<llvm::SmallVector<llvm::Instruction *, 4>> accessGroups;
+  llvm::DenseMap<llvm::Instruction *, unsigned> accessGroupIndices;
+
+  /// The stack buffer for passing the expressions of a run of accesses to the
+  /// runtime (created on demand).
+  llvm::AllocaInst *accessGroupExpressions = nullptr;
+
   /// A record of expression uses that can be short-circuited.
   ///
   /// Most values in a program are concrete, even if they're not constant (in
@@ -369,6 +629,19 @@ private:
   /// Therefore, we keep a record of all the places that construct expressions
   /// and insert the fast path later.
   std::vector<SymbolicComputation> expressionUses;
+
+  /// The slow paths inserted by shortCircuitExpressionUses, each given by its
+  /// first block and the block where it joins the fast path again.
+  std::vector<std::pair<llvm::BasicBlock *, llvm::BasicBlock *>> slowPaths;
+
+  /// The entries of the function's site table, in the order of site indices.
+  std::vector<llvm::Constant *> siteTable;
+
+  /// The index of the function's first site in the module's site table.
+  uint64_t firstSiteIndex;
+
+  /// Strings referenced by the site table (i.e., file and function names).
+  llvm::StringMap<llvm::Constant *> siteStrings;
 };
 
 #endif
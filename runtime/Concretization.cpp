@@ -0,0 +1,206 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the SymCC runtime. If not, see <https://www.gnu.org/licenses/>.
+
+#include "Concretization.h"
+
+#include <fnmatch.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Config.h"
+#include "RuntimeCommon.h"
+#include "SiteTable.h"
+
+bool g_concretizing = false;
+
+namespace {
+
+/// An entry of the policy file.
+struct PolicyEntry {
+  /// The glob that callee names are matched against.
+  std::string pattern;
+
+  /// Do we pin the concretized values?
+  bool pin;
+};
+
+/// A call that is executing and whose outputs we concretize on return.
+struct ActiveCall {
+  uintptr_t siteId;
+  bool pin;
+
+  /// The memory regions that received symbolic data during the call.
+  std::vector<std::pair<uint8_t *, size_t>> writes;
+};
+
+std::vector<PolicyEntry> g_policy;
+
+/// The policy for each site, determined on first use.
+std::unordered_map<uintptr_t, Concretization> g_site_policies;
+
+/// The calls on the stack that the policy covers, innermost last.
+std::vector<ActiveCall> g_active_calls;
+
+/// The maximum size of the stack.
+size_t g_stack_limit;
+
+Concretization lookupPolicy(const char *callee) {
+  if (callee == nullptr)
+    return Concretization::None;
+
+  for (const auto &entry : g_policy) {
+    if (fnmatch(entry.pattern.c_str(), callee, 0) == 0)
+      return entry.pin ? Concretization::Pin : Concretization::Concretize;
+  }
+
+  return Concretization::None;
+}
+
+/// Check whether a memory region may be part of the stack frames that were
+/// released when the callee returned. The stack grows downwards from the given
+/// frame address.
+bool mayBeDeadStack(const uint8_t *addr, const void *frame) {
+  auto *top = static_cast<const uint8_t *>(frame);
+  return (addr < top) && (static_cast<size_t>(top - addr) <= g_stack_limit);
+}
+
+/// Build a constraint stating that the memory region has its current contents,
+/// or return null if the region is concrete.
+SymExpr buildPinningConstraint(uint8_t *addr, size_t length) {
+  SymExpr result = nullptr;
+  for (size_t offset = 0; offset < length; offset += sizeof(uint64_t)) {
+    auto chunk = std::min(length - offset, sizeof(uint64_t));
+    auto *expr = _sym_read_memory(addr + offset, chunk, true);
+    if (expr == nullptr)
+      continue;
+
+    uint64_t value = 0;
+    for (size_t i = 0; i < chunk; i++)
+      value |= uint64_t(addr[offset + i]) << (8 * i);
+
+    auto *equal = _sym_build_equal(expr, _sym_build_integer(value, 8 * chunk));
+    result = (result == nullptr) ? equal : _sym_build_bool_and(result, equal);
+  }
+
+  return result;
+}
+
+} // namespace
+
+void initConcretization() {
+  if (g_config.concretizationPolicyFile.empty())
+    return;
+
+  std::ifstream file(g_config.concretizationPolicyFile);
+  if (!file) {
+    std::stringstream msg;
+    msg << "Can't open the concretization policy file "
+        << g_config.concretizationPolicyFile;
+    throw std::runtime_error(msg.str());
+  }
+
+  // Each line names a function (or a glob matching several), optionally
+  // followed by "pin"; everything after "#" is a comment.
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream entry(line.substr(0, line.find('#')));
+    std::string pattern, option;
+    if (!(entry >> pattern))
+      continue;
+
+    entry >> option;
+    if (!option.empty() && option != "pin") {
+      std::stringstream msg;
+      msg << "Unknown option \"" << option
+          << "\" in the concretization policy for " << pattern;
+      throw std::runtime_error(msg.str());
+    }
+
+    g_policy.push_back({pattern, !option.empty()});
+  }
+
+  struct rlimit stackLimit;
+  g_stack_limit = (getrlimit(RLIMIT_STACK, &stackLimit) == 0 &&
+                   stackLimit.rlim_cur != RLIM_INFINITY)
+                      ? stackLimit.rlim_cur
+                      : size_t(1) << 30;
+  g_concretizing = !g_policy.empty();
+}
+
+Concretization concretizationForSite(uintptr_t siteId) {
+  auto [it, inserted] = g_site_policies.try_emplace(siteId);
+  if (inserted) {
+    // Sites that aren't registered can't name their callee.
+    const auto *info = lookupSite(siteId);
+    it->second = (info != nullptr) ? lookupPolicy(info->callee)
+                                   : Concretization::None;
+  }
+  return it->second;
+}
+
+void concretizationCall(uintptr_t siteId) {
+  auto policy = concretizationForSite(siteId);
+  if (policy != Concretization::None)
+    g_active_calls.push_back({siteId, policy == Concretization::Pin, {}});
+}
+
+void concretizationRet(uintptr_t siteId, const void *frame) {
+  // If the callee exited via longjmp or an exception, we may not see the
+  // return of every call.
+  if (g_active_calls.empty() || g_active_calls.back().siteId != siteId)
+    return;
+
+  auto call = std::move(g_active_calls.back());
+  g_active_calls.pop_back();
+
+  SymExpr pin = nullptr;
+  for (auto [addr, length] : call.writes) {
+    if (call.pin && !mayBeDeadStack(addr, frame)) {
+      if (auto *constraint = buildPinningConstraint(addr, length))
+        pin = (pin == nullptr) ? constraint
+                               : _sym_build_bool_and(pin, constraint);
+    }
+    _sym_memset(addr, nullptr, length);
+  }
+
+  if (pin != nullptr)
+    _sym_assert_constraint(pin);
+}
+
+void recordSymbolicWrite(uint8_t *addr, size_t length) {
+  if (g_active_calls.empty())
+    return;
+
+  // Programs tend to write memory sequentially, or to write the same location
+  // repeatedly, so merge with the previous region where possible.
+  auto &writes = g_active_calls.back().writes;
+  if (!writes.empty()) {
+    auto &[lastAddr, lastLength] = writes.back();
+    if (addr >= lastAddr && addr <= lastAddr + lastLength) {
+      lastLength = std::max(lastLength, size_t(addr + length - lastAddr));
+      return;
+    }
+  }
+
+  writes.emplace_back(addr, length);
+}
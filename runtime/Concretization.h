@@ -0,0 +1,66 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the SymCC runtime. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef CONCRETIZATION_H
+#define CONCRETIZATION_H
+
+#include <cstddef>
+#include <cstdint>
+
+//
+// Concretization policies (see g_config.concretizationPolicyFile).
+//
+// The policy names functions whose outputs aren't worth reasoning about, such
+// as hashes, checksums or decompressors: their expressions rarely lead to a
+// solution and slow down every later query. When such a function returns, its
+// return value and any symbolic data that it wrote to memory become concrete;
+// optionally, a path constraint pins them to their current values, so that new
+// inputs stay consistent with the execution. We identify functions by the
+// callee names of call sites (see SiteTable.h), so only direct calls from
+// instrumented code are affected.
+//
+
+/// Is a concretization policy in effect?
+///
+/// Backends and the memory functions should check this before calling any of
+/// the functions below.
+extern bool g_concretizing;
+
+/// What happens to the outputs of a function.
+enum class Concretization { None, Concretize, Pin };
+
+/// Load the policy if requested in g_config.
+///
+/// Call this after loadConfig.
+void initConcretization();
+
+/// Look up the policy for the callee of the given call site.
+Concretization concretizationForSite(uintptr_t siteId);
+
+/// Record that the program is about to execute the call at the given site.
+void concretizationCall(uintptr_t siteId);
+
+/// Record that the call at the given site has returned, and concretize the
+/// memory written during the call if the policy covers the callee.
+///
+/// The frame is the frame address of _sym_notify_ret (i.e.,
+/// __builtin_frame_address(0)); the callee's stack frame used to be below it,
+/// so we don't pin values that have since been overwritten there.
+void concretizationRet(uintptr_t siteId, const void *frame);
+
+/// Record that the program has written symbolic data to memory.
+void recordSymbolicWrite(uint8_t *addr, size_t length);
+
+#endif
@@ -16,7 +16,9 @@
 #include "Config.h"
 
 #include <algorithm>
+#include <cctype>
 #include <cstddef>
+#include <fstream>
 #include <limits>
 #include <sstream>
 #include <stdexcept>
@@ -38,6 +40,91 @@ bool checkFlagString(std::string value) {
   throw std::runtime_error(msg.str());
 }
 
+/// Parse a list of input offsets and inclusive offset ranges, separated by
+/// commas or white space (e.g., "0-3,7,16-31").
+std::vector<std::pair<size_t, size_t>> parseRanges(const std::string &list) {
+  std::vector<std::pair<size_t, size_t>> ranges;
+
+  std::string item;
+  std::stringstream items(list);
+  auto parseOffset = [&](const std::string &offset) -> size_t {
+    try {
+      size_t length;
+      auto value = std::stoul(offset, &length);
+      if (length == offset.size())
+        return value;
+    } catch (std::logic_error &) {
+      // Report the error below.
+    }
+
+    std::stringstream msg;
+    msg << "Can't parse " << offset << " in the symbolic input ranges "
+        << list;
+    throw std::runtime_error(msg.str());
+  };
+
+  while (items >> item) {
+    std::string range;
+    std::stringstream rangeItems(item);
+    while (std::getline(rangeItems, range, ',')) {
+      if (range.empty())
+        continue;
+
+      auto dash = range.find('-');
+      auto first = parseOffset(range.substr(0, dash));
+      auto last = (dash == std::string::npos)
+                      ? first
+                      : parseOffset(range.substr(dash + 1));
+      if (last < first) {
+        std::stringstream msg;
+        msg << "Invalid symbolic input range " << range;
+        throw std::runtime_error(msg.str());
+      }
+
+      ranges.emplace_back(first, last);
+    }
+  }
+
+  // Sort the ranges and merge the ones that overlap or touch.
+  std::sort(ranges.begin(), ranges.end());
+  std::vector<std::pair<size_t, size_t>> merged;
+  for (const auto &range : ranges) {
+    if (!merged.empty() && range.first <= merged.back().second + 1)
+      merged.back().second = std::max(merged.back().second, range.second);
+    else
+      merged.push_back(range);
+  }
+
+  return merged;
+}
+
+/// Read symbolic input ranges from a file.
+///
+/// The file either contains a list of ranges in the format accepted by
+/// parseRanges, or it is a report of the taint backend, in which case we use
+/// the input bytes that influence branches.
+std::vector<std::pair<size_t, size_t>>
+readRangesFromFile(const std::string &fileName) {
+  std::ifstream file(fileName);
+  if (!file) {
+    std::stringstream msg;
+    msg << "Can't open the symbolic input ranges file " << fileName;
+    throw std::runtime_error(msg.str());
+  }
+
+  static const std::string taintSummary =
+      "# input bytes influencing branches:";
+  std::string line, list;
+  while (std::getline(file, line)) {
+    if (line.compare(0, taintSummary.size(), taintSummary) == 0)
+      return parseRanges(line.substr(taintSummary.size()));
+    if (!line.empty() && line[0] != '#')
+      list += line + "\n";
+  }
+
+  return parseRanges(list);
+}
+
 } // namespace
 
 Config g_config;
@@ -60,6 +147,14 @@ void loadConfig() {
     g_config.input = MemoryInput{};
   }
 
+  auto *symbolicRanges = getenv("SYMCC_SYMBOLIC_RANGES");
+  if (symbolicRanges != nullptr && *symbolicRanges != '\0') {
+    if (*symbolicRanges == '@')
+      g_config.symbolicRanges = readRangesFromFile(symbolicRanges + 1);
+    else
+      g_config.symbolicRanges = parseRanges(symbolicRanges);
+  }
+
   auto *fullyConcrete = getenv("SYMCC_NO_SYMBOLIC_INPUT");
   if (fullyConcrete != nullptr && checkFlagString(fullyConcrete))
     g_config.input = NoInput{};
@@ -68,6 +163,26 @@ void loadConfig() {
   if (logFile != nullptr)
     g_config.logFile = logFile;
 
+  auto *profileFile = getenv("SYMCC_PROFILE_FILE");
+  if (profileFile != nullptr)
+    g_config.profileFile = profileFile;
+
+  auto *traceFile = getenv("SYMCC_TRACE_FILE");
+  if (traceFile != nullptr)
+    g_config.traceFile = traceFile;
+
+  auto *taintReportFile = getenv("SYMCC_TAINT_REPORT_FILE");
+  if (taintReportFile != nullptr)
+    g_config.taintReportFile = taintReportFile;
+
+  auto *concretizationPolicyFile = getenv("SYMCC_CONCRETIZE_POLICY");
+  if (concretizationPolicyFile != nullptr)
+    g_config.concretizationPolicyFile = concretizationPolicyFile;
+
+  auto *inputArray = getenv("SYMCC_INPUT_ARRAY");
+  if (inputArray != nullptr)
+    g_config.inputArray = checkFlagString(inputArray);
+
   auto *pruning = getenv("SYMCC_ENABLE_LINEARIZATION");
   if (pruning != nullptr)
     g_config.pruning = checkFlagString(pruning);
@@ -93,3 +208,23 @@ void loadConfig() {
     }
   }
 }
+
+bool isSymbolicInputByte(size_t offset) {
+  return overlapsSymbolicInput(offset, 1);
+}
+
+bool overlapsSymbolicInput(size_t offset, size_t length) {
+  if (!g_config.symbolicRanges.has_value())
+    return true;
+  if (length == 0)
+    return false;
+
+  const auto &ranges = *g_config.symbolicRanges;
+  // Find the first range that ends at or after the offset.
+  auto range =
+      std::lower_bound(ranges.begin(), ranges.end(), offset,
+                       [](const std::pair<size_t, size_t> &r, size_t o) {
+                         return r.second < o;
+                       });
+  return range != ranges.end() && range->first <= offset + length - 1;
+}
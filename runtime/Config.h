@@ -17,7 +17,10 @@
 #define CONFIG_H
 
 #include <string>
+#include <optional>
+#include <utility>
 #include <variant>
+#include <vector>
 
 /// Marker struct for fully concrete execution.
 struct NoInput {};
@@ -40,12 +43,36 @@ struct Config {
   /// The configuration for our symbolic input.
   InputConfig input = StdinInput{};
 
+  /// The parts of the input to treat symbolically.
+  ///
+  /// Each entry is an inclusive range of input offsets; the ranges are sorted
+  /// and disjoint. Bytes outside these ranges stay concrete. If no ranges are
+  /// configured, the entire input is symbolic.
+  std::optional<std::vector<std::pair<size_t, size_t>>> symbolicRanges;
+
   /// The directory for storing new outputs.
   std::string outputDir = "/tmp/output";
 
   /// The file to log constraint solving information to.
   std::string logFile = "";
 
+  /// The file to write the per-site profile to (empty to disable profiling).
+  std::string profileFile = "";
+
+  /// The file to write the event trace to (empty to disable tracing).
+  std::string traceFile = "";
+
+  /// The file for the taint backend's report (empty for standard error).
+  std::string taintReportFile = "";
+
+  /// The file listing functions whose outputs we concretize (empty to disable
+  /// concretization policies).
+  std::string concretizationPolicyFile = "";
+
+  /// Do we represent the input as a single array instead of one variable per
+  /// byte (simple backend only)?
+  bool inputArray = false;
+
   /// Do we prune expressions on hot paths?
   bool pruning = false;
 
@@ -80,4 +107,10 @@ extern Config g_config;
 /// variable used for configuration cannot be interpreted.
 void loadConfig();
 
+/// Determine whether the input byte at the given offset is symbolic.
+bool isSymbolicInputByte(size_t offset);
+
+/// Determine whether any input byte in the given range is symbolic.
+bool overlapsSymbolicInput(size_t offset, size_t length);
+
 #endif
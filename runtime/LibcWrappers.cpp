@@ -46,6 +46,7 @@
 
 #include "Config.h"
 #include "Shadow.h"
+#include "Tracing.h"
 #include <Runtime.h>
 
 #define SYM(x) x##_symbolized
@@ -58,6 +59,17 @@ int inputFileDescriptor = -1;
 /// The current position in the (symbolic) input.
 uint64_t inputOffset = 0;
 
+/// Consume the next byte of the input file, returning its expression (which is
+/// null if the byte isn't symbolic).
+SymExpr nextInputByte(uint8_t value) {
+  auto offset = inputOffset++;
+  if (isSymbolicInputByte(offset))
+    return _sym_get_input_byte(offset, value);
+
+  _sym_record_input_bytes(offset, &value, 1);
+  return nullptr;
+}
+
 /// Tell the solver to try an alternative value than the given one.
 template <typename V, typename F>
 void tryAlternative(V value, SymExpr valueExpr, F caller) {
@@ -127,6 +139,11 @@ void *SYM(calloc)(size_t nmemb, size_t size) {
 
 void *SYM(mmap64)(void *addr, size_t len, int prot, int flags, int fildes,
                   uint64_t off) {
+  // A fixed mapping replaces whatever was there before, including input that
+  // we may still have to read from an earlier mapping.
+  if ((flags & MAP_FIXED) != 0)
+    unregisterMappedInput(addr, len);
+
   auto *result = mmap64(addr, len, prot, flags, fildes, off);
   _sym_set_return_expression(nullptr);
 
@@ -141,11 +158,11 @@ void *SYM(mmap64)(void *addr, size_t len, int prot, int flags, int fildes,
      */
     inputOffset = off + len;
     // Reading symbolic input.
-    ReadWriteShadow shadow(result, len);
-    uint8_t *resultBytes = (uint8_t *)result;
-    std::generate(shadow.begin(), shadow.end(), [resultBytes, i = 0]() mutable {
-      return _sym_get_input_byte(inputOffset, resultBytes[i++]);
-    });
+    TraceScope trace(TraceEvent::InputRead, len);
+    if ((prot & PROT_WRITE) == 0 && len >= kPageSize)
+      registerMappedInput(result, len, off);
+    else
+      _sym_make_symbolic(result, len, off);
   } else if (!isConcrete(result, len)) {
     ReadWriteShadow shadow(result, len);
     std::fill(shadow.begin(), shadow.end(), nullptr);
@@ -161,6 +178,13 @@ void *SYM(mmap)(void *addr, size_t len, int prot, int flags, int fildes,
   return SYM(mmap64)(addr, len, prot, flags, fildes, off);
 }
 
+int SYM(munmap)(void *addr, size_t len) {
+  unregisterMappedInput(addr, len);
+  auto result = munmap(addr, len);
+  _sym_set_return_expression(nullptr);
+  return result;
+}
+
 int SYM(open)(const char *path, int oflag, mode_t mode) {
   auto result = open(path, oflag, mode);
   _sym_set_return_expression(nullptr);
@@ -183,6 +207,7 @@ ssize_t SYM(read)(int fildes, void *buf, size_t nbyte) {
 
   if (fildes == inputFileDescriptor) {
     // Reading symbolic input.
+    TraceScope trace(TraceEvent::InputRead, result);
     _sym_make_symbolic(buf, result, inputOffset);
     inputOffset += result;
   } else if (!isConcrete(buf, result)) {
@@ -265,6 +290,7 @@ size_t SYM(fread)(void *ptr, size_t size, size_t nmemb, FILE *stream) {
 
   if (fileno(stream) == inputFileDescriptor) {
     // Reading symbolic input.
+    TraceScope trace(TraceEvent::InputRead, result * size);
     _sym_make_symbolic(ptr, result * size, inputOffset);
     inputOffset += result * size;
   } else if (!isConcrete(ptr, result * size)) {
@@ -285,6 +311,7 @@ char *SYM(fgets)(char *str, int n, FILE *stream) {
   if (fileno(stream) == inputFileDescriptor) {
     // Reading symbolic input.
     const auto length = sizeof(char) * strlen(str);
+    TraceScope trace(TraceEvent::InputRead, length);
     _sym_make_symbolic(str, length, inputOffset);
     inputOffset += length;
   } else if (!isConcrete(str, sizeof(char) * strlen(str))) {
@@ -365,11 +392,13 @@ int SYM(getc)(FILE *stream) {
     return result;
   }
 
-  if (fileno(stream) == inputFileDescriptor)
-    _sym_set_return_expression(_sym_build_zext(
-        _sym_get_input_byte(inputOffset++, result), sizeof(int) * 8 - 8));
-  else
+  if (fileno(stream) == inputFileDescriptor) {
+    auto *byteExpr = nextInputByte(result);
+    _sym_set_return_expression(
+        byteExpr ? _sym_build_zext(byteExpr, sizeof(int) * 8 - 8) : nullptr);
+  } else {
     _sym_set_return_expression(nullptr);
+  }
 
   return result;
 }
@@ -381,11 +410,13 @@ int SYM(fgetc)(FILE *stream) {
     return result;
   }
 
-  if (fileno(stream) == inputFileDescriptor)
-    _sym_set_return_expression(_sym_build_zext(
-        _sym_get_input_byte(inputOffset++, result), sizeof(int) * 8 - 8));
-  else
+  if (fileno(stream) == inputFileDescriptor) {
+    auto *byteExpr = nextInputByte(result);
+    _sym_set_return_expression(
+        byteExpr ? _sym_build_zext(byteExpr, sizeof(int) * 8 - 8) : nullptr);
+  } else {
     _sym_set_return_expression(nullptr);
+  }
 
   return result;
 }
@@ -0,0 +1,170 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the SymCC runtime. If not, see <https://www.gnu.org/licenses/>.
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include "Config.h"
+#include "SiteTable.h"
+
+bool g_profiling = false;
+
+namespace {
+
+struct SiteProfile {
+  uint64_t expressions = 0;
+  uint64_t pathConstraints = 0;
+  uint64_t queries = 0;
+  uint64_t sat = 0;
+  uint64_t unsat = 0;
+  uint64_t unknown = 0;
+  uint64_t solverNanoseconds = 0;
+};
+
+/// Profiles of all sites we have seen, indexed by site ID.
+std::unordered_map<uintptr_t, SiteProfile> g_profiles;
+
+/// The site that expressions are currently attributed to.
+SiteProfile *g_current_site = nullptr;
+
+/// Does the backend report individual queries (see initProfiler)?
+bool g_count_queries = true;
+
+const char *siteKindName(uint32_t kind) {
+  switch (kind) {
+  case SYM_SITE_BASIC_BLOCK:
+    return "block";
+  case SYM_SITE_BRANCH:
+    return "branch";
+  case SYM_SITE_CALL:
+    return "call";
+  case SYM_SITE_ALTERNATIVE:
+    return "alternative";
+  default:
+    return "unknown";
+  }
+}
+
+void writeReport() {
+  auto *out = fopen(g_config.profileFile.c_str(), "w");
+  if (out == nullptr) {
+    std::cerr << "Failed to open the profile " << g_config.profileFile
+              << std::endl;
+    return;
+  }
+
+  std::vector<std::pair<uintptr_t, const SiteProfile *>> sorted;
+  sorted.reserve(g_profiles.size());
+  for (const auto &[siteId, profile] : g_profiles)
+    sorted.emplace_back(siteId, &profile);
+
+  std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) {
+    const auto &pa = *a.second;
+    const auto &pb = *b.second;
+    if (pa.solverNanoseconds != pb.solverNanoseconds)
+      return pa.solverNanoseconds > pb.solverNanoseconds;
+    if (pa.queries != pb.queries)
+      return pa.queries > pb.queries;
+    if (pa.expressions != pb.expressions)
+      return pa.expressions > pb.expressions;
+    return a.first < b.first;
+  });
+
+  if (g_count_queries)
+    fprintf(out, "# site\tlocation\tkind\texpressions\tconstraints\tqueries"
+                 "\tsat\tunsat\tunknown\tsolver_ns\n");
+  else
+    fprintf(out, "# site\tlocation\tkind\texpressions\tconstraints"
+                 "\tsolver_ns\n");
+
+  for (const auto &[siteId, profile] : sorted) {
+    // Site IDs outside the table come from the libc wrappers, which identify
+    // themselves by their function address.
+    // The same applies to the pseudo-site for expressions built before the
+    // first site.
+    const auto *info = lookupSite(siteId);
+    const char *file = (info != nullptr && info->file != nullptr) ? info->file
+                                                                   : "??";
+    unsigned line = (info != nullptr) ? info->line : 0;
+    const char *kind = (info != nullptr) ? siteKindName(info->kind) : "libc";
+
+    fprintf(out, "%lu\t%s:%u\t%s\t%llu\t%llu", (unsigned long)siteId, file,
+            line, kind, (unsigned long long)profile->expressions,
+            (unsigned long long)profile->pathConstraints);
+    if (g_count_queries)
+      fprintf(out, "\t%llu\t%llu\t%llu\t%llu",
+              (unsigned long long)profile->queries,
+              (unsigned long long)profile->sat,
+              (unsigned long long)profile->unsat,
+              (unsigned long long)profile->unknown);
+    fprintf(out, "\t%llu\n", (unsigned long long)profile->solverNanoseconds);
+  }
+
+  fclose(out);
+}
+
+} // namespace
+
+void initProfiler(bool countQueries) {
+  if (g_config.profileFile.empty())
+    return;
+
+  g_profiling = true;
+  g_count_queries = countQueries;
+  atexit(writeReport);
+}
+
+void profileSite(uintptr_t siteId) { g_current_site = &g_profiles[siteId]; }
+
+void profileExpression() {
+  // Expressions built before we reach the first site (e.g., by the libc
+  // wrappers during initialization) go to a pseudo-site.
+  if (g_current_site == nullptr)
+    g_current_site = &g_profiles[UINTPTR_MAX];
+
+  g_current_site->expressions++;
+}
+
+void profilePathConstraint(uintptr_t siteId) {
+  g_profiles[siteId].pathConstraints++;
+}
+
+void profileQuery(uintptr_t siteId, QueryResult result, uint64_t nanoseconds) {
+  auto &profile = g_profiles[siteId];
+  profile.queries++;
+  profile.solverNanoseconds += nanoseconds;
+  switch (result) {
+  case QueryResult::Sat:
+    profile.sat++;
+    break;
+  case QueryResult::Unsat:
+    profile.unsat++;
+    break;
+  case QueryResult::Unknown:
+  default:
+    profile.unknown++;
+    break;
+  }
+}
+
+void profileSolverTime(uintptr_t siteId, uint64_t nanoseconds) {
+  g_profiles[siteId].solverNanoseconds += nanoseconds;
+}
@@ -0,0 +1,65 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the SymCC runtime. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+
+//
+// A per-site profiler for the runtime (see g_config.profileFile).
+//
+// Backends report expressions, path constraints and solver queries; the
+// profiler attributes them to sites of the target program and writes a report,
+// sorted by solver time, when the program exits. Sites are mapped to source
+// locations via the site table (see SiteTable.h).
+//
+
+/// Is the profiler enabled?
+///
+/// Backends should check this before calling any of the functions below.
+extern bool g_profiling;
+
+/// The outcome of a solver query.
+enum class QueryResult { Sat, Unsat, Unknown };
+
+/// Enable the profiler if requested in g_config.
+///
+/// Call this after loadConfig. The report is written at exit. Backends that
+/// can't observe individual solver queries pass false for countQueries and
+/// report only the solver time (see profileSolverTime); the report then leaves
+/// out the query columns.
+void initProfiler(bool countQueries = true);
+
+/// Record that execution has reached the given site.
+///
+/// Subsequent expressions are attributed to it.
+void profileSite(uintptr_t siteId);
+
+/// Record that an expression has been built at the current site.
+void profileExpression();
+
+/// Record that a path constraint has been pushed at the given site.
+void profilePathConstraint(uintptr_t siteId);
+
+/// Record a solver query issued for a path constraint at the given site.
+void profileQuery(uintptr_t siteId, QueryResult result,
+                  uint64_t nanoseconds);
+
+/// Record time spent in the solver for a path constraint at the given site,
+/// without knowing how many queries it took.
+void profileSolverTime(uintptr_t siteId, uint64_t nanoseconds);
+
+#endif
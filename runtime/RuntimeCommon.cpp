@@ -16,26 +16,36 @@
 #include <Runtime.h>
 
 #include <algorithm>
-#include <array>
 #include <cassert>
 #include <cstddef>
 #include <numeric>
 #include <stdexcept>
 #include <variant>
 
+#include "Concretization.h"
 #include "Config.h"
 #include "GarbageCollection.h"
 #include "RuntimeCommon.h"
 #include "Shadow.h"
+#include "SiteTable.h"
 
 namespace {
 
-constexpr int kMaxFunctionArguments = 256;
+/// Build the expression for a memory region, treating bytes without a shadow
+/// as constants.
+SymExpr readShadow(uint8_t *addr, size_t length, bool little_endian) {
+  ReadOnlyShadow shadow(addr, length);
+  return std::accumulate(shadow.begin_non_null(), shadow.end_non_null(),
+                         static_cast<SymExpr>(nullptr),
+                         [&](SymExpr result, SymExpr byteExpr) {
+                           if (result == nullptr)
+                             return byteExpr;
 
-/// Global storage for function parameters and the return value.
-SymExpr g_return_value;
-std::array<SymExpr, kMaxFunctionArguments> g_function_arguments;
-// TODO make thread-local
+                           return little_endian
+                                      ? _sym_concat_helper(byteExpr, result)
+                                      : _sym_concat_helper(result, byteExpr);
+                         });
+}
 
 SymExpr buildMinSignedInt(uint8_t bits) {
   return _sym_build_integer((uint64_t)(1) << (bits - 1), bits);
@@ -82,35 +92,46 @@ SymExpr buildOverflowResult(SymExpr result_expr, SymExpr overflow,
                                 : _sym_concat_helper(padding, overflow_byte));
 }
 
+/// The bit in the argument mask that represents the given argument.
+uint64_t argumentBit(uint8_t index) {
+  return uint64_t(1) << std::min<unsigned>(index, SYM_ARGUMENT_MASK_BITS - 1);
+}
+
 } // namespace
 
-void _sym_set_return_expression(SymExpr expr) { g_return_value = expr; }
+// Global storage for function parameters and the return value (see
+// RuntimeCommon.h). TODO make thread-local
+uint64_t _sym_argument_mask;
+SymExpr _sym_argument_expressions[SYM_MAX_FUNCTION_ARGUMENTS];
+SymExpr _sym_return_expression;
+
+void _sym_set_return_expression(SymExpr expr) { _sym_return_expression = expr; }
 
 SymExpr _sym_get_return_expression(void) {
-  auto *result = g_return_value;
+  auto *result = _sym_return_expression;
   // TODO this is a safeguard that can eventually be removed
-  g_return_value = nullptr;
+  _sym_return_expression = nullptr;
   return result;
 }
 
 void _sym_set_parameter_expression(uint8_t index, SymExpr expr) {
-  // if (index == 1) {
-  //   printf("set_param1:%s\n", expr == nullptr? "NULL":_sym_expr_to_string(expr));
-  // }
-  // if (index == 2) {
-  //   printf("set_param2:%s\n", expr == nullptr? "NULL":_sym_expr_to_string(expr));
-  // }
-  g_function_arguments[index] = expr;
+  _sym_argument_expressions[index] = expr;
+  _sym_argument_mask |= argumentBit(index);
 }
 
 SymExpr _sym_get_parameter_expression(uint8_t index) {
-  return g_function_arguments[index];
+  return (_sym_argument_mask & argumentBit(index))
+             ? _sym_argument_expressions[index]
+             : nullptr;
 }
 
 void _sym_memcpy(uint8_t *dest, const uint8_t *src, size_t length) {
   if (isConcrete(src, length) && isConcrete(dest, length))
     return;
 
+  if (g_concretizing)
+    recordSymbolicWrite(dest, length);
+
   ReadOnlyShadow srcShadow(src, length);
   ReadWriteShadow destShadow(dest, length);
   std::copy(srcShadow.begin(), srcShadow.end(), destShadow.begin());
@@ -120,6 +141,9 @@ void _sym_memset(uint8_t *memory, SymExpr value, size_t length) {
   if ((value == nullptr) && isConcrete(memory, length))
     return;
 
+  if (g_concretizing && value != nullptr)
+    recordSymbolicWrite(memory, length);
+
   ReadWriteShadow shadow(memory, length);
   std::fill(shadow.begin(), shadow.end(), value);
 }
@@ -132,6 +156,9 @@ void _sym_memmove(uint8_t *dest, const uint8_t *src, size_t length) {
   if (isConcrete(src, length) && isConcrete(dest, length))
     return;
 
+  if (g_concretizing)
+    recordSymbolicWrite(dest, length);
+
   ReadOnlyShadow srcShadow(src, length);
   ReadWriteShadow destShadow(dest, length);
   if (dest > src)
@@ -155,17 +182,7 @@ SymExpr _sym_read_memory(uint8_t *addr, size_t length, bool little_endian) {
     return nullptr;
 
   // printf("Enter Read Memory %p, %ld\n", addr, length);
-  ReadOnlyShadow shadow(addr, length);
-  SymExpr a = std::accumulate(shadow.begin_non_null(), shadow.end_non_null(),
-                         static_cast<SymExpr>(nullptr),
-                         [&](SymExpr result, SymExpr byteExpr) {
-                           if (result == nullptr)
-                             return byteExpr;
-
-                           return little_endian
-                                      ? _sym_concat_helper(byteExpr, result)
-                                      : _sym_concat_helper(result, byteExpr);
-                         });
+  SymExpr a = readShadow(addr, length, little_endian);
   // printf("Read Memory Expr: %s\n", _sym_expr_to_string(a));
   return a;
 }
@@ -183,6 +200,9 @@ void _sym_write_memory(uint8_t *addr, size_t length, SymExpr expr,
   if (expr == nullptr && isConcrete(addr, length))
     return;
 
+  if (g_concretizing && expr != nullptr)
+    recordSymbolicWrite(addr, length);
+
   ReadWriteShadow shadow(addr, length);
   if (expr == nullptr) {
     std::fill(shadow.begin(), shadow.end(), nullptr);
@@ -203,6 +223,65 @@ void _sym_write_memory(uint8_t *addr, size_t length, SymExpr expr,
   // printf("Write Memory Exit\n");
 }
 
+void _sym_read_memory_multi(uint8_t *addr, size_t count, const size_t *lengths,
+                            SymExpr *exprs, bool little_endian) {
+  size_t total = std::accumulate(lengths, lengths + count, size_t(0));
+  assert(total && "Invalid query for zero-length memory region");
+
+  // Most of the time, the entire region is concrete, and one check is enough.
+  if (isConcrete(addr, total)) {
+    std::fill(exprs, exprs + count, nullptr);
+    return;
+  }
+
+  // Otherwise, walk the shadow to find the parts that need an expression.
+  ReadOnlyShadow shadow(addr, total);
+  auto partBegin = shadow.begin();
+  size_t offset = 0;
+  for (size_t i = 0; i < count; i++) {
+    auto partEnd = std::next(partBegin, lengths[i]);
+    exprs[i] = std::all_of(partBegin, partEnd,
+                           [](SymExpr expr) { return (expr == nullptr); })
+                   ? nullptr
+                   : readShadow(addr + offset, lengths[i], little_endian);
+    partBegin = partEnd;
+    offset += lengths[i];
+  }
+}
+
+void _sym_write_memory_multi(uint8_t *addr, size_t count,
+                             const size_t *lengths, SymExpr *exprs,
+                             bool little_endian) {
+  size_t total = std::accumulate(lengths, lengths + count, size_t(0));
+  assert(total && "Invalid query for zero-length memory region");
+
+  if (std::all_of(exprs, exprs + count,
+                  [](SymExpr expr) { return (expr == nullptr); }) &&
+      isConcrete(addr, total))
+    return;
+
+  if (g_concretizing)
+    recordSymbolicWrite(addr, total);
+
+  // See _sym_write_memory for how we split the expressions into bytes.
+  ReadWriteShadow shadow(addr, total);
+  auto byteShadow = shadow.begin();
+  for (size_t i = 0; i < count; i++) {
+    auto *expr = exprs[i];
+    auto length = lengths[i];
+    for (size_t j = 0; j < length; j++, ++byteShadow) {
+      if (expr == nullptr)
+        *byteShadow = nullptr;
+      else
+        *byteShadow =
+            little_endian
+                ? _sym_extract_helper(expr, 8 * (j + 1) - 1, 8 * j)
+                : _sym_extract_helper(expr, (length - j) * 8 - 1,
+                                      (length - j - 1) * 8);
+    }
+  }
+}
+
 SymExpr _sym_build_extract(SymExpr expr, uint64_t offset, uint64_t length,
                            bool little_endian) {
   size_t totalBits = _sym_bits_helper(expr);
@@ -470,16 +549,61 @@ SymExpr _sym_build_abs(SymExpr expr) {
       _sym_build_sub(_sym_build_integer(0, bits), expr));
 }
 
+void _sym_register_sites(uintptr_t first_id, const SymSiteInfo *sites,
+                         size_t count) {
+  registerSites(first_id, sites, count);
+}
+
+SymExpr _sym_concretize_return(uintptr_t site_id, SymExpr expr,
+                               uint64_t value) {
+  if (!g_concretizing)
+    return expr;
+
+  auto policy = concretizationForSite(site_id);
+  if (policy == Concretization::None)
+    return expr;
+
+  if (policy == Concretization::Pin) {
+    _sym_assert_constraint(_sym_build_equal(
+        expr, _sym_build_integer(value, _sym_bits_helper(expr))));
+  }
+  return nullptr;
+}
+
 void _sym_register_expression_region(SymExpr *start, size_t length) {
   registerExpressionRegion({start, length});
 }
 
 void _sym_make_symbolic(const void *data, size_t byte_length,
                         size_t input_offset) {
+  _sym_record_input_bytes(input_offset, static_cast<const uint8_t *>(data),
+                          byte_length);
+
+  if (!overlapsSymbolicInput(input_offset, byte_length)) {
+    // None of the bytes is in a symbolic range (see SYMCC_SYMBOLIC_RANGES), so
+    // we only need to make sure that the memory is concrete.
+    if (!isConcrete(data, byte_length)) {
+      ReadWriteShadow shadow(data, byte_length);
+      std::fill(shadow.begin(), shadow.end(), nullptr);
+    }
+    return;
+  }
+
+  // Defer the creation of expressions for large chunks of input until the
+  // program actually reads them (see Shadow.h); for small ones, the
+  // bookkeeping isn't worth it.
+  if (byte_length >= kPageSize) {
+    registerLazyInput(data, byte_length, input_offset);
+    return;
+  }
+
   ReadWriteShadow shadow(data, byte_length);
   const uint8_t *data_bytes = reinterpret_cast<const uint8_t *>(data);
   std::generate(shadow.begin(), shadow.end(), [&, i = 0]() mutable {
-    return _sym_get_input_byte(input_offset++, data_bytes[i++]);
+    auto offset = input_offset++;
+    auto value = data_bytes[i++];
+    return isSymbolicInputByte(offset) ? _sym_get_input_byte(offset, value)
+                                       : nullptr;
   });
 }
 
@@ -29,11 +29,15 @@
 #ifndef RUNTIMECOMMON_H
 #define RUNTIMECOMMON_H
 
-/* Marker for expression parameters which may be null. */
 #include "Runtime.h"
+#include "config.h"
+
+#ifdef WITH_SANITIZER_RUNTIME
 #include <dependency.h>
+#endif
+
+/* Marker for expression parameters which may be null. */
 #define nullable
-#include "config.h"
 
 #ifdef __cplusplus
 #include <cstddef>
@@ -171,7 +175,30 @@ size_t _sym_bits_helper(SymExpr expr);
 
 /*
  * Function-call helpers
+ *
+ * Instrumented code passes the expressions of arguments and return values
+ * through the variables below, accessing them directly rather than calling into
+ * the runtime. Before a call, the caller stores the expression of each symbolic
+ * argument in _sym_argument_expressions and sets the argument's bit in
+ * _sym_argument_mask (bit i for argument i); the slots of arguments whose bit
+ * is clear are stale and must be treated as null. The last bit stands for all
+ * remaining arguments, whose slots are therefore always written; arguments
+ * beyond SYM_MAX_FUNCTION_ARGUMENTS don't have slots and are always concrete.
+ * The callee reads and clears the mask on entry, so a function that receives a
+ * mask of zero doesn't use the slots at all. Return values use
+ * _sym_return_expression: the caller sets it to null before the call (in case
+ * the callee isn't instrumented), the callee sets it on return, and the caller
+ * reads it after the call.
+ *
+ * The functions are equivalent accessors for use by the runtime (e.g., in libc
+ * wrappers).
  */
+#define SYM_MAX_FUNCTION_ARGUMENTS 256
+#define SYM_ARGUMENT_MASK_BITS 64
+extern uint64_t _sym_argument_mask;
+extern nullable SymExpr _sym_argument_expressions[SYM_MAX_FUNCTION_ARGUMENTS];
+extern nullable SymExpr _sym_return_expression;
+
 void _sym_set_parameter_expression(uint8_t index, nullable SymExpr expr);
 SymExpr _sym_get_parameter_expression(uint8_t index);
 void _sym_set_return_expression(nullable SymExpr expr);
@@ -182,7 +209,22 @@ SymExpr _sym_get_return_expression(void);
  */
 void _sym_push_path_constraint(nullable SymExpr constraint, int taken,
                                uintptr_t site_id);
+/*
+ * Add a constraint that holds on the current path without trying to solve its
+ * negation (e.g., to pin a value to its concrete value; see
+ * SYMCC_CONCRETIZE_POLICY in docs/Configuration.txt).
+ */
+void _sym_assert_constraint(nullable SymExpr constraint);
 SymExpr _sym_get_input_byte(size_t offset, uint8_t concrete_value);
+/*
+ * Backends that generate new inputs need the concrete value of every input
+ * byte, including the ones that aren't symbolic (see SYMCC_SYMBOLIC_RANGES in
+ * docs/Configuration.txt), so that test cases are complete. The runtime reports
+ * all input bytes via _sym_record_input_bytes, which doesn't build any
+ * expressions.
+ */
+void _sym_record_input_bytes(size_t offset, const uint8_t *values,
+                             size_t length);
 void _sym_make_symbolic(const void *data, size_t byte_length,
                         size_t input_offset);
 #ifdef WITH_SANITIZER_RUNTIME
@@ -196,10 +238,35 @@ void _sym_asan_test_dependency(SymExpr expr);
 
 /*
  * Memory management
+ *
+ * Instrumented code consults _sym_shadow_summary before calling
+ * _sym_read_memory or _sym_write_memory. Entry (a >> G) % N, with G being
+ * SYM_SHADOW_SUMMARY_GRANULARITY_BITS and N being SYM_SHADOW_SUMMARY_ENTRIES,
+ * covers the chunk of 2^G bytes that contains address a. If the entry is zero,
+ * neither the chunk nor the one after it has any shadow, so an access of at
+ * most 2^G bytes starting in the chunk is concrete: loads don't need an
+ * expression, and stores of concrete values don't need to update the shadow.
+ * The runtime sets entries conservatively and never clears them.
  */
+#define SYM_SHADOW_SUMMARY_GRANULARITY_BITS 16
+#define SYM_SHADOW_SUMMARY_ENTRIES (1 << 24)
+extern uint8_t _sym_shadow_summary[SYM_SHADOW_SUMMARY_ENTRIES];
+
 SymExpr _sym_read_memory(uint8_t *addr, size_t length, bool little_endian);
 void _sym_write_memory(uint8_t *addr, size_t length, nullable SymExpr expr,
                        bool little_endian);
+/*
+ * The same for a sequence of adjacent accesses: access i starts where access
+ * i-1 ends (the first one at addr), covers lengths[i] bytes, and reads its
+ * expression into (or writes it from) exprs[i]. Instrumented code uses these
+ * functions for runs of loads or stores in a basic block, so that the runtime
+ * only needs to look up the shadow once.
+ */
+void _sym_read_memory_multi(uint8_t *addr, size_t count, const size_t *lengths,
+                            SymExpr *exprs, bool little_endian);
+void _sym_write_memory_multi(uint8_t *addr, size_t count,
+                             const size_t *lengths, SymExpr *exprs,
+                             bool little_endian);
 void _sym_memcpy(uint8_t *dest, const uint8_t *src, size_t length);
 void _sym_memset(uint8_t *memory, SymExpr value, size_t length);
 void _sym_memmove(uint8_t *dest, const uint8_t *src, size_t length);
@@ -216,6 +283,48 @@ void _sym_notify_call(uintptr_t site_id);
 void _sym_notify_ret(uintptr_t site_id);
 void _sym_notify_basic_block(uintptr_t site_id);
 
+/*
+ * Concretization policies
+ *
+ * After a call whose result has a symbolic expression, instrumented code
+ * passes the expression and the concrete result (zero-extended or converted to
+ * an integer) to _sym_concretize_return, and uses the returned expression
+ * instead. The runtime returns null if its policy says to concretize the
+ * outputs of the callee (see SYMCC_CONCRETIZE_POLICY in
+ * docs/Configuration.txt), and the expression unchanged otherwise.
+ */
+SymExpr _sym_concretize_return(uintptr_t site_id, SymExpr expr,
+                               uint64_t value);
+
+/*
+ * Site table
+ *
+ * The compiler pass describes the sites of each module (i.e., the places that
+ * pass a site ID to the runtime) in a table and registers it from the module
+ * constructor. Site IDs are compile-time constants: the upper
+ * SYM_SITE_INDEX_BITS bits identify the module (by a hash of its source file
+ * name), and the lower ones hold the index of the site in the module's table.
+ * first_id is the ID of the table's first site.
+ */
+#define SYM_SITE_INDEX_BITS (sizeof(uintptr_t) * 4)
+
+enum SymSiteKind {
+  SYM_SITE_BASIC_BLOCK,
+  SYM_SITE_BRANCH,
+  SYM_SITE_CALL,
+  SYM_SITE_ALTERNATIVE
+};
+
+typedef struct {
+  const char *file;   /* null if unknown */
+  uint32_t line;      /* zero if unknown */
+  uint32_t kind;      /* one of SymSiteKind */
+  const char *callee; /* null unless a direct call */
+} SymSiteInfo;
+
+void _sym_register_sites(uintptr_t first_id, const SymSiteInfo *sites,
+                         size_t count);
+
 /*
  * Debugging
  */
@@ -224,9 +333,18 @@ bool _sym_feasible(SymExpr expr);
 
 /*
  * Garbage collection
+ *
+ * Every expression that a backend returns from a build function counts as one
+ * reference for the caller. Instrumented code calls _sym_release when it knows
+ * that it won't use such a reference anymore (e.g., because the value was only
+ * compared or printed), and the backend forgets the expression as soon as all
+ * references are gone. Expressions that end up in memory or in the
+ * function-call ABI are never released this way; the garbage collector finds
+ * them by scanning the shadow and the registered regions.
  */
 void _sym_register_expression_region(SymExpr *start, size_t length);
 void _sym_collect_garbage(void);
+void _sym_release(nullable SymExpr expr);
 
 /*
  * User-facing functionality
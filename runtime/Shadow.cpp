@@ -15,4 +15,151 @@
 
 #include "Shadow.h"
 
-std::map<uintptr_t, SymExpr *> g_shadow_pages;
+#include <vector>
+
+#include "Config.h"
+
+std::map<uintptr_t, SymExpr *> &g_shadow_pages =
+    *new std::map<uintptr_t, SymExpr *>;
+std::map<uintptr_t, LazyInputRegion> g_lazy_input_regions;
+uint8_t _sym_shadow_summary[SYM_SHADOW_SUMMARY_ENTRIES];
+
+namespace {
+
+/// Return the part of the given lazy input region between the two addresses.
+LazyInputRegion sliceRegion(uintptr_t regionStart,
+                            const LazyInputRegion &region, uintptr_t from,
+                            uintptr_t to) {
+  return {to, region.inputOffset + (from - regionStart), region.buffer,
+          region.values + (from - regionStart), region.valuesRecorded};
+}
+
+/// Remove the given memory range from the lazy input regions, and return the
+/// parts of the regions that overlapped with it.
+std::vector<std::pair<uintptr_t, LazyInputRegion>>
+removeLazyInput(uintptr_t start, uintptr_t end) {
+  std::vector<std::pair<uintptr_t, LazyInputRegion>> removed;
+
+  // Start at the last region that begins before the range, if any, because it
+  // may extend into the range.
+  auto it = g_lazy_input_regions.upper_bound(start);
+  if (it != g_lazy_input_regions.begin())
+    --it;
+
+  while (it != g_lazy_input_regions.end() && it->first < end) {
+    auto regionStart = it->first;
+    auto region = it->second;
+    if (region.end <= start) {
+      ++it;
+      continue;
+    }
+
+    it = g_lazy_input_regions.erase(it);
+    if (regionStart < start)
+      g_lazy_input_regions[regionStart] =
+          sliceRegion(regionStart, region, regionStart, start);
+    if (region.end > end)
+      g_lazy_input_regions[end] =
+          sliceRegion(regionStart, region, end, region.end);
+
+    auto overlapStart = std::max(regionStart, start);
+    removed.push_back(
+        {overlapStart, sliceRegion(regionStart, region, overlapStart,
+                                   std::min(region.end, end))});
+  }
+
+  return removed;
+}
+
+/// Report the values of a lazy input region to the backend unless it has seen
+/// them already.
+void recordRegionValues(uintptr_t regionStart, LazyInputRegion &region) {
+  if (region.valuesRecorded)
+    return;
+
+  _sym_record_input_bytes(region.inputOffset, region.values,
+                          region.end - regionStart);
+  region.valuesRecorded = true;
+}
+
+} // namespace
+
+void markShadowSummary(uintptr_t addr, size_t length) {
+  if (length == 0)
+    return;
+
+  // Start one chunk early: an access that begins in the preceding chunk may
+  // extend into the region.
+  uintptr_t first = (addr >> SYM_SHADOW_SUMMARY_GRANULARITY_BITS) - 1;
+  uintptr_t last = (addr + length - 1) >> SYM_SHADOW_SUMMARY_GRANULARITY_BITS;
+  if (last - first >= SYM_SHADOW_SUMMARY_ENTRIES) {
+    memset(_sym_shadow_summary, 1, sizeof(_sym_shadow_summary));
+    return;
+  }
+
+  for (auto chunk = first; chunk != last + 1; chunk++)
+    _sym_shadow_summary[chunk % SYM_SHADOW_SUMMARY_ENTRIES] = 1;
+}
+
+void registerLazyInput(const void *addr, size_t length, size_t inputOffset) {
+  if (length == 0)
+    return;
+
+  auto start = reinterpret_cast<uintptr_t>(addr);
+  auto *bytes = static_cast<const uint8_t *>(addr);
+  auto buffer =
+      std::make_shared<const std::vector<uint8_t>>(bytes, bytes + length);
+  removeLazyInput(start, start + length);
+  g_lazy_input_regions[start] = {start + length, inputOffset, buffer,
+                                 buffer->data(), true};
+  markShadowSummary(start, length);
+}
+
+void registerMappedInput(const void *addr, size_t length, size_t inputOffset) {
+  if (length == 0)
+    return;
+
+  auto start = reinterpret_cast<uintptr_t>(addr);
+  removeLazyInput(start, start + length);
+  g_lazy_input_regions[start] = {start + length, inputOffset, nullptr,
+                                 static_cast<const uint8_t *>(addr), false};
+  markShadowSummary(start, length);
+}
+
+void unregisterMappedInput(const void *addr, size_t length) {
+  auto start = reinterpret_cast<uintptr_t>(addr);
+  for (auto &[regionStart, region] : removeLazyInput(start, start + length))
+    recordRegionValues(regionStart, region);
+}
+
+void recordMappedInput() {
+  for (auto &[regionStart, region] : g_lazy_input_regions)
+    recordRegionValues(regionStart, region);
+}
+
+void materializeInputSlow(uintptr_t addr, size_t length) {
+  // Populate entire pages at a time, so that a program walking over lazy input
+  // byte by byte doesn't fragment the region map. Shadow is allocated per page
+  // anyway.
+  auto start = pageStart(addr);
+  auto end = pageStart(addr + length + kPageSize - 1);
+
+  // Update the region map before creating any expressions; the shadow
+  // iterators below must not see the regions again.
+  for (auto &[regionStart, region] : removeLazyInput(start, end)) {
+    recordRegionValues(regionStart, region);
+
+    // Take the values from the copy (or the read-only mapping); the memory may
+    // have changed since.
+    auto inputOffset = region.inputOffset;
+    auto *bytes = region.values;
+    std::generate(WriteShadowIterator(regionStart),
+                  WriteShadowIterator(region.end), [&, i = 0]() mutable {
+                    auto offset = inputOffset++;
+                    auto value = bytes[i++];
+                    return isSymbolicInputByte(offset)
+                               ? _sym_get_input_byte(offset, value)
+                               : nullptr;
+                  });
+  }
+}
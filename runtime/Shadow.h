@@ -20,10 +20,12 @@
 #include <cassert>
 #include <cstring>
 #include <map>
+#include <memory>
+#include <vector>
 
 #include <Runtime.h>
 
-#include <z3.h>
+#include "Tracing.h"
 
 //
 // This file is dedicated to the management of shadow memory.
@@ -53,7 +55,88 @@ constexpr uintptr_t pageOffset(uintptr_t addr) {
 
 /// A mapping from page addresses to the corresponding shadow regions. Each
 /// shadow is large enough to hold one expression per byte on the shadowed page.
-extern std::map<uintptr_t, SymExpr *> g_shadow_pages;
+///
+/// Like the shadow regions themselves, the map is never destroyed, so that
+/// program exit doesn't have to walk it.
+extern std::map<uintptr_t, SymExpr *> &g_shadow_pages;
+
+/// Record in _sym_shadow_summary that the given memory region may have a
+/// shadow, so that instrumented code doesn't skip accesses to it (see
+/// RuntimeCommon.h).
+void markShadowSummary(uintptr_t addr, size_t length);
+
+//
+// Symbolic input is materialized lazily: when the program reads a large chunk
+// of input (or maps the input file), we only record which input offsets the
+// memory holds, and we create the byte expressions when the program first
+// accesses the corresponding shadow. Programs that skim large files thus only
+// pay for the bytes that they actually look at. We keep a copy of the input
+// values because the program may have overwritten the memory by the time we
+// materialize it. Read-only mappings of the input file are the exception: their
+// contents can't change, so we read the values from the mapping itself and
+// report them to the backend (see _sym_record_input_bytes) only when we need
+// them.
+//
+
+/// A memory region holding symbolic input whose shadow hasn't been populated
+/// yet.
+struct LazyInputRegion {
+  /// The end address of the region (exclusive).
+  uintptr_t end;
+
+  /// The input offset of the region's first byte.
+  size_t inputOffset;
+
+  /// The buffer holding the input values at the time of registration, shared
+  /// by all regions split off from the original one. Null for read-only
+  /// mappings.
+  std::shared_ptr<const std::vector<uint8_t>> buffer;
+
+  /// The input value of the region's first byte (pointing into buffer or into
+  /// the mapping).
+  const uint8_t *values;
+
+  /// Whether the backend has seen the input values. Always true for copied
+  /// input, which we report at registration.
+  bool valuesRecorded;
+};
+
+/// The lazy input regions, indexed by their start address. Regions don't
+/// overlap.
+extern std::map<uintptr_t, LazyInputRegion> g_lazy_input_regions;
+
+/// Record that the given memory region holds input starting at the given
+/// offset, replacing any previous lazy input in the region. The current
+/// contents of the memory are taken as the input values.
+void registerLazyInput(const void *addr, size_t length, size_t inputOffset);
+
+/// Like registerLazyInput, but for a read-only mapping of the input file. We
+/// neither copy nor report the values up front; the mapping must stay readable
+/// and unchanged until unregisterMappedInput.
+void registerMappedInput(const void *addr, size_t length, size_t inputOffset);
+
+/// Drop any lazy input in the given memory region because the program is about
+/// to unmap it, reporting the values of mapped input that the backend hasn't
+/// seen yet.
+void unregisterMappedInput(const void *addr, size_t length);
+
+/// Report the values of all mapped input that the backend hasn't seen yet.
+/// Backends that generate test cases call this before writing one, so that the
+/// test case is complete.
+void recordMappedInput();
+
+/// Populate the shadow of any lazy input in the given memory region.
+void materializeInputSlow(uintptr_t addr, size_t length);
+
+/// Make sure that the shadow of the given memory region is up to date, i.e.,
+/// that it contains expressions for any input that we haven't materialized yet.
+/// All shadow accesses go through this function (via ReadOnlyShadow,
+/// ReadWriteShadow and isConcrete), so the rest of the runtime never sees lazy
+/// input.
+inline void materializeInput(uintptr_t addr, size_t length) {
+  if (!g_lazy_input_regions.empty())
+    materializeInputSlow(addr, length);
+}
 
 /// An iterator that walks over the shadow bytes corresponding to a memory
 /// region. If there is no shadow for any given memory address, it just returns
@@ -167,10 +250,12 @@ protected:
     if (auto *shadow = getShadow(address))
       return shadow;
 
+    TraceScope trace(TraceEvent::ShadowAllocation, pageStart(address));
     auto *newShadow =
         static_cast<SymExpr *>(malloc(kPageSize * sizeof(SymExpr)));
     memset(newShadow, 0, kPageSize * sizeof(SymExpr));
     g_shadow_pages[pageStart(address)] = newShadow;
+    markShadowSummary(pageStart(address), kPageSize);
     return newShadow + pageOffset(address);
   }
 };
@@ -179,7 +264,9 @@ protected:
 struct ReadOnlyShadow {
   template <typename T>
   ReadOnlyShadow(T *addr, size_t len)
-      : address_(reinterpret_cast<uintptr_t>(addr)), length_(len) {}
+      : address_(reinterpret_cast<uintptr_t>(addr)), length_(len) {
+    materializeInput(address_, length_);
+  }
 
   ReadShadowIterator begin() const { return ReadShadowIterator(address_); }
   ReadShadowIterator end() const {
@@ -201,7 +288,9 @@ struct ReadOnlyShadow {
 /// A view on shadow memory that allows modifications.
 template <typename T> struct ReadWriteShadow {
   ReadWriteShadow(T *addr, size_t len)
-      : address_(reinterpret_cast<uintptr_t>(addr)), length_(len) {}
+      : address_(reinterpret_cast<uintptr_t>(addr)), length_(len) {
+    materializeInput(address_, length_);
+  }
 
   WriteShadowIterator begin() { return WriteShadowIterator(address_); }
   WriteShadowIterator end() { return WriteShadowIterator(address_ + length_); }
@@ -213,8 +302,10 @@ template <typename T> struct ReadWriteShadow {
 /// Check whether the indicated memory range is concrete, i.e., there is no
 /// symbolic byte in the entire region.
 template <typename T> bool isConcrete(T *addr, size_t nbytes) {
-  // Fast path for allocations within one page.
   auto byteBuf = reinterpret_cast<uintptr_t>(addr);
+  materializeInput(byteBuf, nbytes);
+
+  // Fast path for allocations within one page.
   if (pageStart(byteBuf) == pageStart(byteBuf + nbytes) &&
       !g_shadow_pages.count(pageStart(byteBuf)))
     return true;
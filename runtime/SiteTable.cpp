@@ -0,0 +1,54 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the SymCC runtime. If not, see <https://www.gnu.org/licenses/>.
+
+#include "SiteTable.h"
+
+#include <iostream>
+#include <unordered_map>
+
+namespace {
+
+/// The site table of a module.
+struct ModuleSites {
+  const SymSiteInfo *sites;
+  size_t count;
+};
+
+/// The site tables of all registered modules, indexed by the module part of
+/// their site IDs.
+std::unordered_map<uintptr_t, ModuleSites> g_modules;
+
+} // namespace
+
+void registerSites(uintptr_t firstId, const SymSiteInfo *sites, size_t count) {
+  auto [it, inserted] = g_modules.try_emplace(firstId >> SYM_SITE_INDEX_BITS,
+                                              ModuleSites{sites, count});
+  if (!inserted) {
+    std::cerr << "Warning: two modules have the same site IDs (are there "
+                 "several source files with the same name?); the locations "
+                 "of their sites may be reported incorrectly"
+              << std::endl;
+  }
+}
+
+const SymSiteInfo *lookupSite(uintptr_t siteId) {
+  auto it = g_modules.find(siteId >> SYM_SITE_INDEX_BITS);
+  if (it == g_modules.end())
+    return nullptr;
+
+  auto index = siteId & ((uintptr_t(1) << SYM_SITE_INDEX_BITS) - 1);
+  const auto &module = it->second;
+  return (index < module.count) ? &module.sites[index] : nullptr;
+}
@@ -0,0 +1,34 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the SymCC runtime. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef SITETABLE_H
+#define SITETABLE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <Runtime.h>
+
+/// Register the site table of a module, given the ID of its first site (see
+/// _sym_register_sites). The table must stay valid for the rest of the run.
+void registerSites(uintptr_t firstId, const SymSiteInfo *sites, size_t count);
+
+/// Look up the description of a site, or return null if the ID is unknown.
+///
+/// Site IDs passed by the libc wrappers are addresses and thus typically
+/// unknown.
+const SymSiteInfo *lookupSite(uintptr_t siteId);
+
+#endif
@@ -0,0 +1,174 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the SymCC runtime. If not, see <https://www.gnu.org/licenses/>.
+
+#include "Tracing.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Config.h"
+
+bool g_tracing = false;
+
+namespace {
+
+/// The number of events per thread that we keep (must be a power of two).
+constexpr size_t kTraceBufferSize = 1 << 16;
+
+struct TraceRecord {
+  uint64_t start;
+  uint64_t end;
+  uint64_t argument;
+  TraceEvent event;
+};
+
+struct TraceBuffer {
+  explicit TraceBuffer(long threadId)
+      : records(kTraceBufferSize), threadId(threadId) {}
+
+  std::vector<TraceRecord> records;
+
+  /// The total number of events recorded so far (including overwritten ones).
+  uint64_t recorded = 0;
+
+  long threadId;
+};
+
+/// All thread buffers; we only take the lock when a thread records its first
+/// event and when we write the trace.
+std::vector<std::unique_ptr<TraceBuffer>> g_trace_buffers;
+std::mutex g_trace_buffers_mutex;
+
+thread_local TraceBuffer *t_trace_buffer = nullptr;
+
+/// Reference points for converting timestamps to wall-clock time.
+uint64_t g_trace_start_timestamp;
+std::chrono::steady_clock::time_point g_trace_start_time;
+
+TraceBuffer *createTraceBuffer() {
+  std::lock_guard<std::mutex> lock(g_trace_buffers_mutex);
+  g_trace_buffers.push_back(
+      std::make_unique<TraceBuffer>(syscall(SYS_gettid)));
+  return g_trace_buffers.back().get();
+}
+
+const char *eventName(TraceEvent event) {
+  switch (event) {
+  case TraceEvent::SolverQuery:
+    return "solver query";
+  case TraceEvent::GarbageCollection:
+    return "garbage collection";
+  case TraceEvent::ShadowAllocation:
+    return "shadow allocation";
+  case TraceEvent::InputRead:
+    return "input read";
+  default:
+    return "unknown";
+  }
+}
+
+const char *argumentName(TraceEvent event) {
+  switch (event) {
+  case TraceEvent::SolverQuery:
+    return "site";
+  case TraceEvent::GarbageCollection:
+    return "expressions";
+  case TraceEvent::ShadowAllocation:
+    return "page";
+  case TraceEvent::InputRead:
+    return "bytes";
+  default:
+    return "argument";
+  }
+}
+
+void writeTrace() {
+  // Calibrate the timestamps against the steady clock over the entire run.
+  auto endTimestamp = traceTimestamp();
+  auto endTime = std::chrono::steady_clock::now();
+  double elapsedMicroseconds =
+      std::chrono::duration<double, std::micro>(endTime - g_trace_start_time)
+          .count();
+  double microsecondsPerTick =
+      (endTimestamp > g_trace_start_timestamp)
+          ? elapsedMicroseconds / (endTimestamp - g_trace_start_timestamp)
+          : 0;
+
+  auto *out = fopen(g_config.traceFile.c_str(), "w");
+  if (out == nullptr) {
+    std::cerr << "Failed to open the trace file " << g_config.traceFile
+              << std::endl;
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(g_trace_buffers_mutex);
+  auto processId = getpid();
+  bool first = true;
+  fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  for (const auto &buffer : g_trace_buffers) {
+    // Walk the ring buffer from the oldest to the newest event.
+    uint64_t begin = (buffer->recorded > kTraceBufferSize)
+                         ? buffer->recorded - kTraceBufferSize
+                         : 0;
+    for (uint64_t i = begin; i < buffer->recorded; i++) {
+      const auto &record = buffer->records[i & (kTraceBufferSize - 1)];
+      fprintf(out,
+              "%s\n{\"name\":\"%s\",\"cat\":\"symcc\",\"ph\":\"X\","
+              "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%ld,"
+              "\"args\":{\"%s\":%llu}}",
+              first ? "" : ",", eventName(record.event),
+              (record.start - g_trace_start_timestamp) * microsecondsPerTick,
+              (record.end - record.start) * microsecondsPerTick,
+              (int)processId, buffer->threadId, argumentName(record.event),
+              (unsigned long long)record.argument);
+      first = false;
+    }
+  }
+  fprintf(out, "\n]}\n");
+  fclose(out);
+}
+
+} // namespace
+
+void initTracing() {
+  if (g_config.traceFile.empty())
+    return;
+
+  g_trace_start_timestamp = traceTimestamp();
+  g_trace_start_time = std::chrono::steady_clock::now();
+  g_tracing = true;
+  atexit(writeTrace);
+}
+
+void traceEvent(TraceEvent event, uint64_t start, uint64_t end,
+                uint64_t argument) {
+  if (t_trace_buffer == nullptr)
+    t_trace_buffer = createTraceBuffer();
+
+  auto index = t_trace_buffer->recorded & (kTraceBufferSize - 1);
+  auto &record = t_trace_buffer->records[index];
+  record.start = start;
+  record.end = end;
+  record.argument = argument;
+  record.event = event;
+  t_trace_buffer->recorded++;
+}
@@ -0,0 +1,92 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the SymCC runtime. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+//
+// An event trace for the runtime (see g_config.traceFile).
+//
+// Each thread records events into its own fixed-size ring buffer, so recording
+// needs neither locks nor allocation; once a buffer is full, the oldest events
+// are overwritten. At exit, we write all buffers to a JSON file in the Chrome
+// trace event format, which chrome://tracing and Perfetto can display.
+//
+
+/// Is tracing enabled?
+extern bool g_tracing;
+
+/// The kinds of events we record.
+enum class TraceEvent : uint32_t {
+  SolverQuery,       // argument: site ID
+  GarbageCollection, // argument: number of expressions before collection
+  ShadowAllocation,  // argument: address of the shadowed page
+  InputRead,         // argument: number of bytes read
+};
+
+/// Enable tracing if requested in g_config.
+///
+/// Call this after loadConfig. The trace is written at exit.
+void initTracing();
+
+/// Return the current timestamp in an unspecified unit.
+///
+/// On x86 we read the time-stamp counter; the conversion to wall-clock time
+/// happens when we write the trace.
+inline uint64_t traceTimestamp() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+/// Record an event in the current thread's buffer.
+void traceEvent(TraceEvent event, uint64_t start, uint64_t end,
+                uint64_t argument);
+
+/// Record an event that lasts as long as the object lives.
+class TraceScope {
+public:
+  explicit TraceScope(TraceEvent event, uint64_t argument = 0)
+      : event_(event), argument_(argument),
+        start_(g_tracing ? traceTimestamp() : 0) {}
+
+  ~TraceScope() {
+    if (g_tracing)
+      traceEvent(event_, start_, traceTimestamp(), argument_);
+  }
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+  void setArgument(uint64_t argument) { argument_ = argument; }
+
+private:
+  TraceEvent event_;
+  uint64_t argument_;
+  uint64_t start_;
+};
+
+#endif
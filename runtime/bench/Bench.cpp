@@ -0,0 +1,306 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the SymCC runtime. If not, see <https://www.gnu.org/licenses/>.
+
+//
+// Microbenchmarks for the runtime's hot paths.
+//
+// We drive the runtime's C interface directly, without an instrumented program,
+// and print the results as JSON on standard output. An optional command-line
+// argument restricts the run to benchmarks whose name contains it. See
+// docs/Benchmarking.txt for details.
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <Runtime.h>
+#include <Shadow.h>
+
+namespace {
+
+struct Result {
+  std::string name;
+  uint64_t iterations;
+  uint64_t nanoseconds;
+};
+
+std::vector<Result> g_results;
+const char *g_filter = nullptr;
+
+/// Volatile sink to keep the compiler from optimizing away concrete work.
+volatile uintptr_t g_sink;
+
+/// Run the benchmark body the given number of times and record the result.
+void bench(const std::string &name, uint64_t iterations,
+           const std::function<void(uint64_t)> &body) {
+  if (g_filter != nullptr && name.find(g_filter) == std::string::npos)
+    return;
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < iterations; i++)
+    body(i);
+  auto end = std::chrono::steady_clock::now();
+
+  g_results.push_back(
+      {name, iterations,
+       static_cast<uint64_t>(
+           std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+               .count())});
+}
+
+/// Input byte expressions, created once.
+std::vector<SymExpr> g_input;
+
+SymExpr inputWord(size_t index, uint8_t bits) {
+  auto *expr = g_input[index % g_input.size()];
+  return (bits > 8) ? _sym_build_zext(expr, bits - 8) : expr;
+}
+
+void benchExpressionBuilders() {
+  using Builder = SymExpr (*)(SymExpr, SymExpr);
+  const std::pair<const char *, Builder> binaryBuilders[] = {
+      {"add", _sym_build_add},
+      {"mul", _sym_build_mul},
+      {"unsigned_div", _sym_build_unsigned_div},
+      {"and", _sym_build_and},
+      {"shift_left", _sym_build_shift_left},
+      {"equal", _sym_build_equal},
+      {"unsigned_less_than", _sym_build_unsigned_less_than},
+  };
+
+  for (const auto &[name, builder] : binaryBuilders) {
+    bench(std::string("build/") + name, 100'000, [builder = builder](uint64_t i) {
+      g_sink ^= reinterpret_cast<uintptr_t>(
+          builder(inputWord(i, 32), _sym_build_integer(i, 32)));
+    });
+  }
+
+  bench("build/integer", 100'000, [](uint64_t i) {
+    g_sink ^= reinterpret_cast<uintptr_t>(_sym_build_integer(i, 64));
+  });
+  bench("build/zext", 100'000, [](uint64_t i) {
+    g_sink ^= reinterpret_cast<uintptr_t>(_sym_build_zext(inputWord(i, 8), 24));
+  });
+  bench("build/trunc", 100'000, [](uint64_t i) {
+    g_sink ^= reinterpret_cast<uintptr_t>(_sym_build_trunc(inputWord(i, 32), 8));
+  });
+  bench("build/concat", 100'000, [](uint64_t i) {
+    g_sink ^= reinterpret_cast<uintptr_t>(
+        _sym_concat_helper(inputWord(i, 8), inputWord(i + 1, 8)));
+  });
+  bench("build/extract", 100'000, [](uint64_t i) {
+    g_sink ^= reinterpret_cast<uintptr_t>(
+        _sym_extract_helper(inputWord(i, 32), 15, 8));
+  });
+}
+
+/// Make every n-th byte of the buffer symbolic (none for n = 0) and clear the
+/// rest.
+void makeSymbolicEvery(uint8_t *buffer, size_t length, size_t n) {
+  for (size_t i = 0; i < length; i++)
+    _sym_write_memory(buffer + i, 1,
+                      (n != 0 && i % n == 0) ? inputWord(i, 8) : nullptr,
+                      true);
+}
+
+void benchMemory() {
+  constexpr size_t kBufferSize = 4 * kPageSize;
+  alignas(kPageSize) static uint8_t buffer[kBufferSize];
+
+  // Densities are expressed as "every n-th byte is symbolic".
+  const std::pair<const char *, size_t> densities[] = {
+      {"concrete", 0}, {"sparse", 16}, {"half", 2}, {"symbolic", 1}};
+  const size_t widths[] = {1, 2, 4, 8, 16};
+
+  for (const auto &[densityName, every] : densities) {
+    makeSymbolicEvery(buffer, kBufferSize, every);
+    for (auto width : widths) {
+      bench("read_memory/" + std::to_string(width) + "/" + densityName,
+            100'000, [width = width](uint64_t i) {
+              auto offset = (i * width) % (kBufferSize - width);
+              g_sink ^= reinterpret_cast<uintptr_t>(
+                  _sym_read_memory(buffer + offset, width, true));
+            });
+    }
+  }
+
+  // A struct of four 4-byte fields, accessed field by field or all at once.
+  const size_t fieldLengths[] = {4, 4, 4, 4};
+  for (const auto &[densityName, every] : densities) {
+    makeSymbolicEvery(buffer, kBufferSize, every);
+    bench(std::string("read_memory_fields/separate/") + densityName, 100'000,
+          [](uint64_t i) {
+            auto offset = (i * 16) % (kBufferSize - 16);
+            for (size_t field = 0; field < 4; field++)
+              g_sink ^= reinterpret_cast<uintptr_t>(
+                  _sym_read_memory(buffer + offset + 4 * field, 4, true));
+          });
+    bench(std::string("read_memory_fields/multi/") + densityName, 100'000,
+          [&fieldLengths](uint64_t i) {
+            auto offset = (i * 16) % (kBufferSize - 16);
+            SymExpr exprs[4];
+            _sym_read_memory_multi(buffer + offset, 4, fieldLengths, exprs,
+                                   true);
+            g_sink ^= reinterpret_cast<uintptr_t>(exprs[0]);
+          });
+  }
+
+  for (auto width : widths) {
+    auto *symbolicValue = inputWord(0, 8);
+    for (size_t i = 1; i < width; i++)
+      symbolicValue = _sym_concat_helper(inputWord(i, 8), symbolicValue);
+
+    bench("write_memory/" + std::to_string(width) + "/concrete", 100'000,
+          [width = width](uint64_t i) {
+            auto offset = (i * width) % (kBufferSize - width);
+            _sym_write_memory(buffer + offset, width, nullptr, true);
+          });
+    bench("write_memory/" + std::to_string(width) + "/symbolic", 100'000,
+          [width = width, symbolicValue](uint64_t i) {
+            auto offset = (i * width) % (kBufferSize - width);
+            _sym_write_memory(buffer + offset, width, symbolicValue, true);
+          });
+  }
+
+  auto *symbolicField = _sym_concat_helper(
+      _sym_concat_helper(inputWord(3, 8), inputWord(2, 8)),
+      _sym_concat_helper(inputWord(1, 8), inputWord(0, 8)));
+  bench("write_memory_fields/separate", 100'000, [symbolicField](uint64_t i) {
+    auto offset = (i * 16) % (kBufferSize - 16);
+    for (size_t field = 0; field < 4; field++)
+      _sym_write_memory(buffer + offset + 4 * field, 4,
+                        (field == 0) ? symbolicField : nullptr, true);
+  });
+  bench("write_memory_fields/multi", 100'000,
+        [symbolicField, &fieldLengths](uint64_t i) {
+          auto offset = (i * 16) % (kBufferSize - 16);
+          SymExpr exprs[] = {symbolicField, nullptr, nullptr, nullptr};
+          _sym_write_memory_multi(buffer + offset, 4, fieldLengths, exprs,
+                                  true);
+        });
+
+  static uint8_t destination[kBufferSize];
+  const size_t spans[] = {16, 256, kPageSize, kBufferSize};
+  for (const auto &[densityName, every] : densities) {
+    makeSymbolicEvery(buffer, kBufferSize, every);
+    for (auto span : spans) {
+      bench("memcpy/" + std::to_string(span) + "/" + densityName, 1'000,
+            [span = span](uint64_t) { _sym_memcpy(destination, buffer, span); });
+    }
+  }
+
+  // isConcrete on memory without any shadow takes the fast path; on shadowed
+  // memory it has to inspect every byte.
+  alignas(kPageSize) static uint8_t unshadowed[kPageSize];
+  bench("is_concrete/unshadowed", 1'000'000, [](uint64_t) {
+    g_sink ^= isConcrete(unshadowed + 8, 64);
+  });
+  makeSymbolicEvery(buffer, kBufferSize, 0);
+  for (auto span : spans) {
+    bench("is_concrete/" + std::to_string(span) + "/shadowed", 10'000,
+          [span = span](uint64_t) { g_sink ^= isConcrete(buffer, span); });
+  }
+}
+
+void benchGarbageCollection() {
+  // GC cost depends on the number of shadow pages it has to scan.
+  const size_t pageCounts[] = {16, 256, 1024};
+  size_t allocated = 0;
+  static std::vector<uint8_t *> pages;
+
+  // Get rid of the garbage that the other benchmarks left behind.
+  _sym_collect_garbage();
+
+  for (auto count : pageCounts) {
+    for (; allocated < count; allocated++) {
+      auto *page = static_cast<uint8_t *>(aligned_alloc(kPageSize, kPageSize));
+      _sym_write_memory(page, 1, inputWord(allocated, 8), true);
+      pages.push_back(page);
+    }
+
+    bench("gc/" + std::to_string(count) + "_pages", 10,
+          [](uint64_t) { _sym_collect_garbage(); });
+  }
+}
+
+void benchPathConstraints() {
+  // The concrete input is all zeros, so "input[i] == 1" is never taken and
+  // each push results in one query for the alternative.
+  bench("path_constraint/query", 200, [](uint64_t i) {
+    auto *constraint =
+        _sym_build_equal(inputWord(i, 8), _sym_build_integer(1, 8));
+    _sym_push_path_constraint(constraint, false, i);
+  });
+
+  bench("path_constraint/concrete", 1'000'000, [](uint64_t i) {
+    _sym_push_path_constraint(nullptr, true, i);
+  });
+}
+
+void printResults() {
+  printf("{\n  \"backend\": \"%s\",\n  \"results\": [", SYMCC_BENCH_BACKEND);
+  for (size_t i = 0; i < g_results.size(); i++) {
+    const auto &result = g_results[i];
+    printf("%s\n    {\"name\": \"%s\", \"iterations\": %llu, "
+           "\"total_ns\": %llu, \"ns_per_op\": %.2f}",
+           (i == 0) ? "" : ",", result.name.c_str(),
+           (unsigned long long)result.iterations,
+           (unsigned long long)result.nanoseconds,
+           (double)result.nanoseconds / result.iterations);
+  }
+  printf("\n  ]\n}\n");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc > 2) {
+    fprintf(stderr, "Usage: %s [filter]\n", argv[0]);
+    return 1;
+  }
+  if (argc == 2)
+    g_filter = argv[1];
+
+  // Symbolic input comes from _sym_get_input_byte only, solver output is
+  // discarded, and garbage collection runs whenever we ask for it. The QSYM
+  // backend needs an existing output directory.
+  char outputDir[] = "/tmp/symcc-bench.XXXXXX";
+  if (mkdtemp(outputDir) == nullptr) {
+    perror("mkdtemp");
+    return 1;
+  }
+  setenv("SYMCC_MEMORY_INPUT", "1", 1);
+  setenv("SYMCC_OUTPUT_DIR", outputDir, 1);
+  setenv("SYMCC_LOG_FILE", "/dev/null", 1);
+  setenv("SYMCC_GC_THRESHOLD", "0", 1);
+  _sym_initialize();
+
+  for (size_t i = 0; i < 256; i++)
+    g_input.push_back(_sym_get_input_byte(i, 0));
+  _sym_register_expression_region(g_input.data(), g_input.size());
+
+  benchExpressionBuilders();
+  benchMemory();
+  benchGarbageCollection();
+  benchPathConstraints();
+
+  printResults();
+  return 0;
+}
@@ -0,0 +1,362 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the SymCC runtime. If not, see <https://www.gnu.org/licenses/>.
+
+//
+// A backend that does as little as possible.
+//
+// It implements the entire interface, but expressions don't carry any content,
+// and we never call a solver. Running a program against this backend therefore
+// measures the cost of the instrumentation itself (i.e., the calls into the
+// runtime and the management of shadow memory), which is a useful baseline for
+// optimizing the compiler pass. At exit, we print how often the instrumented
+// program called into the various parts of the runtime.
+//
+
+#include <Runtime.h>
+
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Config.h"
+#include "LibcWrappers.h"
+#include "Profiler.h"
+#include "Tracing.h"
+
+namespace {
+
+/// Indicate whether the runtime has been initialized.
+std::atomic_flag g_initialized = ATOMIC_FLAG_INIT;
+
+/// The kinds of calls that we count.
+enum Counter {
+  kExpressionsBuilt,
+  kInputBytes,
+  kSymbolicPathConstraints,
+  kConcretePathConstraints,
+  kCalls,
+  kReturns,
+  kBasicBlocks,
+  kGarbageCollections,
+  kReleasedExpressions,
+  kNumCounters
+};
+
+const char *const kCounterNames[kNumCounters] = {
+    "expressions built",
+    "input bytes",
+    "symbolic path constraints",
+    "concrete path constraints",
+    "function calls",
+    "function returns",
+    "basic blocks",
+    "garbage collections",
+    "released expressions",
+};
+
+std::array<uint64_t, kNumCounters> g_counters;
+
+FILE *g_log = stderr;
+
+void printCounters() {
+  fprintf(g_log, "Calls into the no-op backend:\n");
+  for (int i = 0; i < kNumCounters; i++)
+    fprintf(g_log, "  %-27s %llu\n", kCounterNames[i],
+            (unsigned long long)g_counters[i]);
+  fflush(g_log);
+}
+
+/// Create an expression of the given width.
+///
+/// We encode the width in the pointer and set the lowest bit, so expressions
+/// are never null and never point to valid memory.
+SymExpr makeExpression(size_t bits) {
+  g_counters[kExpressionsBuilt]++;
+  if (g_profiling)
+    profileExpression();
+
+  return reinterpret_cast<SymExpr>((static_cast<uintptr_t>(bits) << 1) | 1);
+}
+
+size_t bitsOf(SymExpr expr) { return reinterpret_cast<uintptr_t>(expr) >> 1; }
+
+} // namespace
+
+void _sym_initialize(void) {
+  if (g_initialized.test_and_set())
+    return;
+
+  loadConfig();
+  initProfiler();
+  initTracing();
+  initLibcWrappers();
+  fprintf(stderr, "This is SymCC running with the no-op backend\n"
+                  "It doesn't build expressions or solve constraints; use it "
+                  "to measure instrumentation overhead\n");
+
+  if (!g_config.logFile.empty()) {
+    g_log = fopen(g_config.logFile.c_str(), "w");
+    if (g_log == nullptr)
+      g_log = stderr;
+  }
+  atexit(printCounters);
+}
+
+//
+// Construction of simple values
+//
+
+SymExpr _sym_build_integer(uint64_t, uint8_t bits) {
+  return makeExpression(bits);
+}
+
+SymExpr _sym_build_integer128(uint64_t, uint64_t) {
+  return makeExpression(128);
+}
+
+SymExpr _sym_build_float(double, int is_double) {
+  return makeExpression(is_double ? 64 : 32);
+}
+
+SymExpr _sym_build_null_pointer(void) {
+  return makeExpression(8 * sizeof(void *));
+}
+
+SymExpr _sym_build_true(void) { return makeExpression(1); }
+SymExpr _sym_build_false(void) { return makeExpression(1); }
+SymExpr _sym_build_bool(bool) { return makeExpression(1); }
+
+//
+// Operations that preserve the width of their first operand
+//
+
+#define DEF_SAME_WIDTH_BUILDER(name)                                           \
+  SymExpr _sym_build_##name(SymExpr a, SymExpr) {                              \
+    return makeExpression(bitsOf(a));                                          \
+  }
+
+DEF_SAME_WIDTH_BUILDER(add)
+DEF_SAME_WIDTH_BUILDER(sub)
+DEF_SAME_WIDTH_BUILDER(mul)
+DEF_SAME_WIDTH_BUILDER(unsigned_div)
+DEF_SAME_WIDTH_BUILDER(signed_div)
+DEF_SAME_WIDTH_BUILDER(unsigned_rem)
+DEF_SAME_WIDTH_BUILDER(signed_rem)
+DEF_SAME_WIDTH_BUILDER(shift_left)
+DEF_SAME_WIDTH_BUILDER(logical_shift_right)
+DEF_SAME_WIDTH_BUILDER(arithmetic_shift_right)
+DEF_SAME_WIDTH_BUILDER(and)
+DEF_SAME_WIDTH_BUILDER(or)
+DEF_SAME_WIDTH_BUILDER(xor)
+DEF_SAME_WIDTH_BUILDER(bool_and)
+DEF_SAME_WIDTH_BUILDER(bool_or)
+DEF_SAME_WIDTH_BUILDER(bool_xor)
+DEF_SAME_WIDTH_BUILDER(fp_add)
+DEF_SAME_WIDTH_BUILDER(fp_sub)
+DEF_SAME_WIDTH_BUILDER(fp_mul)
+DEF_SAME_WIDTH_BUILDER(fp_div)
+DEF_SAME_WIDTH_BUILDER(fp_rem)
+
+#undef DEF_SAME_WIDTH_BUILDER
+
+SymExpr _sym_build_neg(SymExpr expr) { return makeExpression(bitsOf(expr)); }
+SymExpr _sym_build_not(SymExpr expr) { return makeExpression(bitsOf(expr)); }
+SymExpr _sym_build_fp_abs(SymExpr a) { return makeExpression(bitsOf(a)); }
+SymExpr _sym_build_fp_neg(SymExpr a) { return makeExpression(bitsOf(a)); }
+
+SymExpr _sym_build_ite(SymExpr, SymExpr a, SymExpr) {
+  return makeExpression(bitsOf(a));
+}
+
+//
+// Comparisons (producing Booleans)
+//
+
+#define DEF_COMPARISON_BUILDER(name)                                           \
+  SymExpr _sym_build_##name(SymExpr, SymExpr) { return makeExpression(1); }
+
+DEF_COMPARISON_BUILDER(signed_less_than)
+DEF_COMPARISON_BUILDER(signed_less_equal)
+DEF_COMPARISON_BUILDER(signed_greater_than)
+DEF_COMPARISON_BUILDER(signed_greater_equal)
+DEF_COMPARISON_BUILDER(unsigned_less_than)
+DEF_COMPARISON_BUILDER(unsigned_less_equal)
+DEF_COMPARISON_BUILDER(unsigned_greater_than)
+DEF_COMPARISON_BUILDER(unsigned_greater_equal)
+DEF_COMPARISON_BUILDER(equal)
+DEF_COMPARISON_BUILDER(not_equal)
+DEF_COMPARISON_BUILDER(float_ordered_greater_than)
+DEF_COMPARISON_BUILDER(float_ordered_greater_equal)
+DEF_COMPARISON_BUILDER(float_ordered_less_than)
+DEF_COMPARISON_BUILDER(float_ordered_less_equal)
+DEF_COMPARISON_BUILDER(float_ordered_equal)
+DEF_COMPARISON_BUILDER(float_ordered_not_equal)
+DEF_COMPARISON_BUILDER(float_ordered)
+DEF_COMPARISON_BUILDER(float_unordered)
+DEF_COMPARISON_BUILDER(float_unordered_greater_than)
+DEF_COMPARISON_BUILDER(float_unordered_greater_equal)
+DEF_COMPARISON_BUILDER(float_unordered_less_than)
+DEF_COMPARISON_BUILDER(float_unordered_less_equal)
+DEF_COMPARISON_BUILDER(float_unordered_equal)
+DEF_COMPARISON_BUILDER(float_unordered_not_equal)
+
+#undef DEF_COMPARISON_BUILDER
+
+//
+// Casts
+//
+
+SymExpr _sym_build_sext(SymExpr expr, uint8_t bits) {
+  if (expr == nullptr)
+    return nullptr;
+  return makeExpression(bitsOf(expr) + bits);
+}
+
+SymExpr _sym_build_zext(SymExpr expr, uint8_t bits) {
+  if (expr == nullptr)
+    return nullptr;
+  return makeExpression(bitsOf(expr) + bits);
+}
+
+SymExpr _sym_build_trunc(SymExpr expr, uint8_t bits) {
+  if (expr == nullptr)
+    return nullptr;
+  return makeExpression(bits);
+}
+
+SymExpr _sym_build_int_to_float(SymExpr, int is_double, int) {
+  return makeExpression(is_double ? 64 : 32);
+}
+
+SymExpr _sym_build_float_to_float(SymExpr, int to_double) {
+  return makeExpression(to_double ? 64 : 32);
+}
+
+SymExpr _sym_build_bits_to_float(SymExpr expr, int to_double) {
+  if (expr == nullptr)
+    return nullptr;
+  return makeExpression(to_double ? 64 : 32);
+}
+
+SymExpr _sym_build_float_to_bits(SymExpr expr) {
+  if (expr == nullptr)
+    return nullptr;
+  return makeExpression(bitsOf(expr));
+}
+
+SymExpr _sym_build_float_to_signed_integer(SymExpr, uint8_t bits) {
+  return makeExpression(bits);
+}
+
+SymExpr _sym_build_float_to_unsigned_integer(SymExpr, uint8_t bits) {
+  return makeExpression(bits);
+}
+
+SymExpr _sym_build_bool_to_bit(SymExpr expr) {
+  if (expr == nullptr)
+    return nullptr;
+  return makeExpression(1);
+}
+
+//
+// Bit-array helpers
+//
+
+SymExpr _sym_concat_helper(SymExpr a, SymExpr b) {
+  return makeExpression(bitsOf(a) + bitsOf(b));
+}
+
+SymExpr _sym_extract_helper(SymExpr, size_t first_bit, size_t last_bit) {
+  return makeExpression(first_bit - last_bit + 1);
+}
+
+size_t _sym_bits_helper(SymExpr expr) { return bitsOf(expr); }
+
+//
+// Constraint handling
+//
+
+void _sym_push_path_constraint(SymExpr constraint, int, uintptr_t site_id) {
+  if (constraint == nullptr) {
+    g_counters[kConcretePathConstraints]++;
+    return;
+  }
+
+  g_counters[kSymbolicPathConstraints]++;
+  if (g_profiling)
+    profilePathConstraint(site_id);
+}
+
+void _sym_assert_constraint(SymExpr) {}
+
+SymExpr _sym_get_input_byte(size_t, uint8_t) {
+  g_counters[kInputBytes]++;
+  return makeExpression(8);
+}
+
+void _sym_record_input_bytes(size_t, const uint8_t *, size_t) {}
+
+//
+// Call-stack tracing
+//
+
+void _sym_notify_call(uintptr_t) { g_counters[kCalls]++; }
+
+void _sym_notify_ret(uintptr_t site_id) {
+  g_counters[kReturns]++;
+  if (g_profiling)
+    profileSite(site_id);
+}
+
+void _sym_notify_basic_block(uintptr_t site_id) {
+  g_counters[kBasicBlocks]++;
+  if (g_profiling)
+    profileSite(site_id);
+}
+
+//
+// Debugging
+//
+
+const char *_sym_expr_to_string(SymExpr expr) {
+  static char buffer[64];
+  snprintf(buffer, sizeof(buffer), "<%zu-bit expression>", bitsOf(expr));
+  return buffer;
+}
+
+bool _sym_feasible(SymExpr) { return true; }
+
+//
+// Garbage collection
+//
+
+void _sym_collect_garbage() {
+  // There is nothing to collect; expressions don't own any memory.
+  g_counters[kGarbageCollections]++;
+}
+
+void _sym_release(SymExpr expr) {
+  if (expr != nullptr)
+    g_counters[kReleasedExpressions]++;
+}
+
+//
+// Test-case handling
+//
+
+void symcc_set_test_case_handler(TestCaseHandler) {
+  // We never generate test cases.
+}
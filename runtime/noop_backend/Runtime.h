@@ -0,0 +1,26 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the SymCC runtime. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+// The no-op backend never looks at expressions, so it doesn't allocate them:
+// expressions are opaque tagged values that only record their width in bits
+// (see Runtime.cpp).
+struct NoopExpr;
+typedef struct NoopExpr *SymExpr;
+#include <RuntimeCommon.h>
+
+#endif
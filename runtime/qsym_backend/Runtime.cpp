@@ -35,12 +35,14 @@
 #endif
 
 #include <atomic>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <iterator>
 #include <map>
 #include <unordered_set>
 #include <variant>
+#include <vector>
 
 #if HAVE_FILESYSTEM
 #include <filesystem>
@@ -48,10 +50,6 @@
 #include <experimental/filesystem>
 #endif
 
-#ifdef DEBUG_RUNTIME
-#include <chrono>
-#endif
-
 // C
 #include <cstdint>
 #include <cstdio>
@@ -67,9 +65,12 @@
 #include <llvm/ADT/ArrayRef.h>
 
 // Runtime
+#include <Concretization.h>
 #include <Config.h>
 #include <LibcWrappers.h>
+#include <Profiler.h>
 #include <Shadow.h>
+#include <Tracing.h>
 
 namespace qsym {
 
@@ -85,16 +86,35 @@ namespace {
 /// Indicate whether the runtime has been initialized.
 std::atomic_flag g_initialized = ATOMIC_FLAG_INIT;
 
+/// An expression that we have passed to client code, and the number of
+/// references that client code may still hold (see _sym_release).
+struct AllocatedExpression {
+  qsym::ExprRef expr;
+  size_t references = 0;
+};
+
 /// A mapping of all expressions that we have ever received from QSYM to the
 /// corresponding shared pointers on the heap.
 ///
 /// We can't expect C clients to handle std::shared_ptr, so we maintain a single
-/// copy per expression in order to keep the expression alive. The garbage
-/// collector decides when to release our shared pointer.
+/// copy per expression in order to keep the expression alive. Client code
+/// releases it explicitly when possible, and otherwise the garbage collector
+/// decides when to release our shared pointer.
 ///
 /// std::map seems to perform slightly better than std::unordered_map on our
 /// workload.
-std::map<SymExpr, qsym::ExprRef> allocatedExpressions;
+///
+/// We never destroy the map: releasing all expressions one by one would make
+/// program exit slow, and the memory is released with the process anyway.
+std::map<SymExpr, AllocatedExpression> &allocatedExpressions =
+    *new std::map<SymExpr, AllocatedExpression>;
+
+/// The expressions for input bytes, indexed by offset.
+std::vector<qsym::ExprRef> g_input_bytes;
+
+/// The concrete input bytes recorded before the solver was set up (see
+/// initSolver), indexed by offset.
+std::vector<uint8_t> g_pending_input_values;
 
 // TODO lack Garbage collection, may cause occupy large memory
 std::unordered_map<qsym::DependencySet*, std::pair<SymExpr, uintptr_t>> g_delay_constraint_queue;
@@ -103,11 +123,16 @@ qsym::DependencySet g_exact_dependencies;
 SymExpr registerExpression(const qsym::ExprRef &expr) {
   SymExpr rawExpr = expr.get();
 
-  if (allocatedExpressions.count(rawExpr) == 0) {
+  if (g_profiling)
+    profileExpression();
+
+  auto &allocated = allocatedExpressions[rawExpr];
+  if (allocated.expr == nullptr) {
     // We don't know this expression yet. Create a copy of the shared pointer to
     // keep the expression alive.
-    allocatedExpressions[rawExpr] = expr;
+    allocated.expr = expr;
   }
+  allocated.references++;
 
   return rawExpr;
 }
@@ -143,7 +168,18 @@ public:
     inputs_[offset] = value;
   }
 
+  /// Add a constraint without solving its negation (unlike addJcc).
+  void assertConstraint(const qsym::ExprRef &constraint) {
+    if (constraint->isConcrete())
+      return;
+
+    addConstraint(constraint, /* taken */ true, /* is_interesting */ false);
+  }
+
   void saveValues(const std::string &suffix) override {
+    // Input from read-only mappings reaches us only on demand (see Shadow.h).
+    recordMappedInput();
+
     if (auto handler = g_test_case_handler) {
       auto values = getConcreteValues();
       handler(values.data(), values.size());
@@ -155,6 +191,26 @@ public:
 
 EnhancedQsymSolver *g_enhanced_solver;
 
+/// Set up the solver and the expression builder.
+///
+/// We defer this until the program reads its first symbolic input byte:
+/// without symbolic input, the program never builds expressions, so runs that
+/// don't get to the point of reading input don't pay for creating the Z3
+/// context or loading the AFL coverage map. The same holds for runs whose input
+/// is entirely outside SYMCC_SYMBOLIC_RANGES; we buffer the concrete bytes and
+/// hand them to the solver here.
+void initSolver() {
+  qsym::g_z3_context = new z3::context{};
+  g_enhanced_solver = new EnhancedQsymSolver{};
+  qsym::g_solver = g_enhanced_solver; // for QSYM-internal use
+  qsym::g_expr_builder = g_config.pruning ? qsym::PruneExprBuilder::create()
+                                          : qsym::SymbolicExprBuilder::create();
+
+  for (size_t offset = 0; offset < g_pending_input_values.size(); offset++)
+    g_enhanced_solver->pushInputByte(offset, g_pending_input_values[offset]);
+  g_pending_input_values = {};
+}
+
 } // namespace
 
 using namespace qsym;
@@ -170,6 +226,11 @@ void _sym_initialize(void) {
     return;
 
   loadConfig();
+  // QSYM solves inside addJcc, and Solver::check isn't virtual, so we can't
+  // observe individual queries or their results (see EnhancedQsymSolver).
+  initProfiler(/* countQueries */ false);
+  initTracing();
+  initConcretization();
   initLibcWrappers();
   std::cerr << "This is SymCC running with the QSYM backend" << std::endl;
   if (std::holds_alternative<NoInput>(g_config.input)) {
@@ -187,12 +248,6 @@ void _sym_initialize(void) {
               << std::endl;
     exit(-1);
   }
-
-  g_z3_context = new z3::context{};
-  g_enhanced_solver = new EnhancedQsymSolver{};
-  g_solver = g_enhanced_solver; // for QSYM-internal use
-  g_expr_builder = g_config.pruning ? PruneExprBuilder::create()
-                                    : SymbolicExprBuilder::create();
 }
 
 SymExpr _sym_build_integer(uint64_t value, uint8_t bits) {
@@ -238,7 +293,7 @@ SymExpr _sym_build_bool(bool value) {
 #define DEF_BINARY_EXPR_BUILDER(name, qsymName)                                \
   SymExpr _sym_build_##name(SymExpr a, SymExpr b) {                            \
     return registerExpression(g_expr_builder->create##qsymName(                \
-        allocatedExpressions.at(a), allocatedExpressions.at(b)));              \
+        allocatedExpressions.at(a).expr, allocatedExpressions.at(b).expr));    \
   }
 
 DEF_BINARY_EXPR_BUILDER(add, Add)
@@ -275,18 +330,18 @@ DEF_BINARY_EXPR_BUILDER(xor, Xor)
 
 SymExpr _sym_build_neg(SymExpr expr) {
   return registerExpression(
-      g_expr_builder->createNeg(allocatedExpressions.at(expr)));
+      g_expr_builder->createNeg(allocatedExpressions.at(expr).expr));
 }
 
 SymExpr _sym_build_not(SymExpr expr) {
   return registerExpression(
-      g_expr_builder->createNot(allocatedExpressions.at(expr)));
+      g_expr_builder->createNot(allocatedExpressions.at(expr).expr));
 }
 
 SymExpr _sym_build_ite(SymExpr cond, SymExpr a, SymExpr b) {
   return registerExpression(g_expr_builder->createIte(
-      allocatedExpressions.at(cond), allocatedExpressions.at(a),
-      allocatedExpressions.at(b)));
+      allocatedExpressions.at(cond).expr, allocatedExpressions.at(a).expr,
+      allocatedExpressions.at(b).expr));
 }
 
 SymExpr _sym_build_sext(SymExpr expr, uint8_t bits) {
@@ -294,7 +349,7 @@ SymExpr _sym_build_sext(SymExpr expr, uint8_t bits) {
     return nullptr;
 
   return registerExpression(g_expr_builder->createSExt(
-      allocatedExpressions.at(expr), bits + expr->bits()));
+      allocatedExpressions.at(expr).expr, bits + expr->bits()));
 }
 
 SymExpr _sym_build_zext(SymExpr expr, uint8_t bits) {
@@ -302,7 +357,7 @@ SymExpr _sym_build_zext(SymExpr expr, uint8_t bits) {
     return nullptr;
 
   return registerExpression(g_expr_builder->createZExt(
-      allocatedExpressions.at(expr), bits + expr->bits()));
+      allocatedExpressions.at(expr).expr, bits + expr->bits()));
 }
 
 SymExpr _sym_build_trunc(SymExpr expr, uint8_t bits) {
@@ -310,7 +365,7 @@ SymExpr _sym_build_trunc(SymExpr expr, uint8_t bits) {
     return nullptr;
 
   return registerExpression(
-      g_expr_builder->createTrunc(allocatedExpressions.at(expr), bits));
+      g_expr_builder->createTrunc(allocatedExpressions.at(expr).expr, bits));
 }
 
 void _sym_push_path_constraint(SymExpr constraint, int taken,
@@ -320,12 +375,39 @@ void _sym_push_path_constraint(SymExpr constraint, int taken,
   if (constraint == nullptr)
     return;
 
+  // QSYM doesn't tell us whether (or how often) it queried the solver, so we
+  // only record the time spent in addJcc.
+  std::chrono::steady_clock::time_point queryStart;
+  if (g_profiling) {
+    profilePathConstraint(site_id);
+    queryStart = std::chrono::steady_clock::now();
+  }
+
+  TraceScope trace(TraceEvent::SolverQuery, site_id);
+
 #ifdef WITH_SANITIZER_RUNTIME
   // printf("\nPush Constaint:%s\n, taken:%d\n", _sym_expr_to_string(constraint), taken);
-  g_solver->addJcc(allocatedExpressions.at(constraint), taken != 0, site_id, false);
+  g_solver->addJcc(allocatedExpressions.at(constraint).expr, taken != 0,
+                   site_id, false);
 #else
-  g_solver->addJcc(allocatedExpressions.at(constraint), taken != 0, site_id);
+  g_solver->addJcc(allocatedExpressions.at(constraint).expr, taken != 0,
+                   site_id);
 #endif
+
+  if (g_profiling) {
+    auto queryTime = std::chrono::steady_clock::now() - queryStart;
+    profileSolverTime(
+        site_id,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(queryTime)
+            .count());
+  }
+}
+
+void _sym_assert_constraint(SymExpr constraint) {
+  if (constraint == nullptr)
+    return;
+
+  g_enhanced_solver->assertConstraint(allocatedExpressions.at(constraint).expr);
 }
 
 #ifdef WITH_SANITIZER_RUNTIME
@@ -333,11 +415,12 @@ void _sym_asan_push_path_constraint(SymExpr constraint, int taken, uintptr_t sit
   if (constraint == nullptr)
     return;
 
-  g_solver->addJcc(allocatedExpressions.at(constraint), taken != 0, site_id, true);
+  g_solver->addJcc(allocatedExpressions.at(constraint).expr, taken != 0,
+                   site_id, true);
 }
 
 void _sym_asan_test_dependency(SymExpr constraint) {
-  ExprRef node = allocatedExpressions.at(constraint);
+  ExprRef node = allocatedExpressions.at(constraint).expr;
   printf("DependencySet-------\n");
   for (auto &index : *node->getDependencies()) {
     printf("%ld\n", index);
@@ -346,7 +429,7 @@ void _sym_asan_test_dependency(SymExpr constraint) {
 }
 
 void _sym_asan_insert_symbolic_addr_node(SymExpr value, SymExpr addr, uintptr_t concrete_addr) {
-  ExprRef node = allocatedExpressions.at(value);
+  ExprRef node = allocatedExpressions.at(value).expr;
   DependencySet *dep = node->getDependencies();
   if (std::includes(g_exact_dependencies.begin(), g_exact_dependencies.end(), dep->begin(), dep->end())) return;
   // check for the repeat dependency, may introduce large overhead
@@ -359,7 +442,7 @@ void _sym_asan_insert_symbolic_addr_node(SymExpr value, SymExpr addr, uintptr_t
 
 void _sym_asan_constraint_verify(SymExpr expr) {
   if (g_delay_constraint_queue.empty()) return;
-  ExprRef node = allocatedExpressions.at(expr);
+  ExprRef node = allocatedExpressions.at(expr).expr;
   DependencySet br_dep = *node->getDependencies(); 
   for(auto iter = g_delay_constraint_queue.begin(); iter != g_delay_constraint_queue.end(); iter++) {
     DependencySet dep = *iter->first;
@@ -385,18 +468,48 @@ bool _sym_asan_is_symexpr_exact(SymExpr expr) {
 #endif
 
 SymExpr _sym_get_input_byte(size_t offset, uint8_t value) {
+  if (g_enhanced_solver == nullptr)
+    initSolver();
+
+  // Reuse the expression if the program reads the same input byte again (e.g.,
+  // after seeking back in the input file); the cache keeps it alive.
+  if (offset < g_input_bytes.size() && g_input_bytes[offset] != nullptr)
+    return registerExpression(g_input_bytes[offset]);
+
   g_enhanced_solver->pushInputByte(offset, value);
-  return registerExpression(g_expr_builder->createRead(offset));
+  auto expr = g_expr_builder->createRead(offset);
+  if (g_input_bytes.size() <= offset)
+    g_input_bytes.resize(offset + 1);
+  g_input_bytes[offset] = expr;
+
+  return registerExpression(expr);
+}
+
+void _sym_record_input_bytes(size_t offset, const uint8_t *values,
+                             size_t length) {
+  // The solver writes new test cases based on these values. We don't set it up
+  // just for concrete bytes, though; runs without symbolic input should stay
+  // cheap.
+  if (g_enhanced_solver == nullptr) {
+    if (g_pending_input_values.size() < offset + length)
+      g_pending_input_values.resize(offset + length);
+    std::copy(values, values + length,
+              g_pending_input_values.begin() + offset);
+    return;
+  }
+
+  for (size_t i = 0; i < length; i++)
+    g_enhanced_solver->pushInputByte(offset + i, values[i]);
 }
 
 SymExpr _sym_concat_helper(SymExpr a, SymExpr b) {
   return registerExpression(g_expr_builder->createConcat(
-      allocatedExpressions.at(a), allocatedExpressions.at(b)));
+      allocatedExpressions.at(a).expr, allocatedExpressions.at(b).expr));
 }
 
 SymExpr _sym_extract_helper(SymExpr expr, size_t first_bit, size_t last_bit) {
   return registerExpression(g_expr_builder->createExtract(
-      allocatedExpressions.at(expr), last_bit, first_bit - last_bit + 1));
+      allocatedExpressions.at(expr).expr, last_bit, first_bit - last_bit + 1));
 }
 
 size_t _sym_bits_helper(SymExpr expr) { return expr->bits(); }
@@ -406,7 +519,7 @@ SymExpr _sym_build_bool_to_bit(SymExpr expr) {
     return nullptr;
 
   return registerExpression(
-      g_expr_builder->boolToBit(allocatedExpressions.at(expr), 1));
+      g_expr_builder->boolToBit(allocatedExpressions.at(expr).expr, 1));
 }
 
 //
@@ -453,14 +566,26 @@ UNSUPPORTED(SymExpr _sym_build_float_to_unsigned_integer(SymExpr, uint8_t))
 //
 
 void _sym_notify_call(uintptr_t site_id) {
+  if (g_concretizing)
+    concretizationCall(site_id);
+
   g_call_stack_manager.visitCall(site_id);
 }
 
 void _sym_notify_ret(uintptr_t site_id) {
+  if (g_profiling)
+    profileSite(site_id);
+
+  if (g_concretizing)
+    concretizationRet(site_id, __builtin_frame_address(0));
+
   g_call_stack_manager.visitRet(site_id);
 }
 
 void _sym_notify_basic_block(uintptr_t site_id) {
+  if (g_profiling)
+    profileSite(site_id);
+
   g_call_stack_manager.visitBasicBlock(site_id);
 }
 
@@ -498,6 +623,8 @@ void _sym_collect_garbage() {
   if (allocatedExpressions.size() < g_config.garbageCollectionThreshold)
     return;
 
+  TraceScope trace(TraceEvent::GarbageCollection, allocatedExpressions.size());
+
 #ifdef DEBUG_RUNTIME
   auto start = std::chrono::high_resolution_clock::now();
 #endif
@@ -525,6 +652,16 @@ void _sym_collect_garbage() {
 #endif
 }
 
+void _sym_release(SymExpr expr) {
+  auto it = allocatedExpressions.find(expr);
+  if (it == allocatedExpressions.end() || --it->second.references > 0)
+    return;
+
+  // Dropping our shared pointer frees the expression unless other expressions
+  // (or QSYM itself, e.g., for path constraints) still use it.
+  allocatedExpressions.erase(it);
+}
+
 //
 // Test-case handling
 //
@@ -18,20 +18,22 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstdio>
 #include <cstring>
 #include <iostream>
+#include <map>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
-#ifndef NDEBUG
-#include <chrono>
-#endif
-
+#include "Concretization.h"
 #include "Config.h"
 #include "GarbageCollection.h"
 #include "LibcWrappers.h"
+#include "Profiler.h"
 #include "Shadow.h"
+#include "Tracing.h"
 
 #ifndef NDEBUG
 // Helper to print pointers properly.
@@ -52,7 +54,7 @@ namespace {
 /// Indicate whether the runtime has been initialized.
 std::atomic_flag g_initialized = ATOMIC_FLAG_INIT;
 
-/// The global Z3 context.
+/// The global Z3 context (null until we see symbolic input; see initSolver).
 Z3_context g_context;
 
 /// The global floating-point rounding mode.
@@ -64,8 +66,86 @@ Z3_solver g_solver; // TODO make thread-local
 // Some global constants for efficiency.
 Z3_ast g_null_pointer, g_true, g_false;
 
+/// A model assigning the concrete input values to the input variables.
+///
+/// We use it to concretize expressions when pruning is enabled (see
+/// g_config.pruning).
+Z3_model g_input_model;
+
 FILE *g_log = stderr;
 
+//
+// Input as an array
+//
+// By default, each input byte is a separate bit-vector variable. If
+// g_config.inputArray is set, the input is instead a single array from 64-bit
+// offsets to bytes, and input bytes are "select" terms with constant indices.
+// Queries then contain a single free symbol regardless of the input size, and
+// we extract from models only the indices that the solver actually
+// instantiated.
+//
+
+/// The expressions for input bytes, indexed by offset.
+std::vector<SymExpr> g_input_bytes;
+
+/// The array representing the input (if g_config.inputArray is set).
+Z3_ast g_input_array;
+
+/// The interpretation of the input array in g_input_model (if
+/// g_config.inputArray is set). It maps each offset to the concrete input byte.
+Z3_func_interp g_input_interp;
+
+/// Collect the input offsets that an expression reads from the input array.
+void collectInputOffsets(Z3_ast expr, std::set<Z3_ast> &visited,
+                         std::set<uint64_t> &offsets) {
+  if (Z3_get_ast_kind(g_context, expr) != Z3_APP_AST ||
+      !visited.insert(expr).second)
+    return;
+
+  auto app = Z3_to_app(g_context, expr);
+  auto decl = Z3_get_app_decl(g_context, app);
+  if (Z3_get_decl_kind(g_context, decl) == Z3_OP_SELECT &&
+      Z3_is_eq_ast(g_context, Z3_get_app_arg(g_context, app, 0),
+                   g_input_array)) {
+    uint64_t offset;
+    if (Z3_get_numeral_uint64(g_context, Z3_get_app_arg(g_context, app, 1),
+                              &offset)) {
+      offsets.insert(offset);
+      return;
+    }
+  }
+
+  for (unsigned i = 0; i < Z3_get_app_num_args(g_context, app); i++)
+    collectInputOffsets(Z3_get_app_arg(g_context, app, i), visited, offsets);
+}
+
+/// Print the input bytes that a model assigns to the input array.
+///
+/// Rather than printing the model's value for the entire array, we only
+/// instantiate the indices that the current query touches; the rest of the
+/// input can keep its current value.
+void printInputArrayModel(Z3_model model) {
+  std::set<Z3_ast> visited;
+  std::set<uint64_t> offsets;
+  auto assertions = Z3_solver_get_assertions(g_context, g_solver);
+  Z3_ast_vector_inc_ref(g_context, assertions);
+  for (unsigned i = 0; i < Z3_ast_vector_size(g_context, assertions); i++)
+    collectInputOffsets(Z3_ast_vector_get(g_context, assertions, i), visited,
+                        offsets);
+
+  for (auto offset : offsets) {
+    Z3_ast value;
+    uint64_t concreteValue;
+    if (Z3_model_eval(g_context, model, g_input_bytes[offset],
+                      /* model_completion */ true, &value) &&
+        Z3_get_numeral_uint64(g_context, value, &concreteValue))
+      fprintf(g_log, "stdin%lu -> #x%02lx\n", (unsigned long)offset,
+              (unsigned long)concreteValue);
+  }
+
+  Z3_ast_vector_dec_ref(g_context, assertions);
+}
+
 #ifndef NDEBUG
 [[maybe_unused]] void dump_known_regions() {
   std::cerr << "Known regions:" << std::endl;
@@ -91,37 +171,81 @@ SymExpr build_variable(const char *name, uint8_t bits) {
   return result;
 }
 
-/// The set of all expressions we have ever passed to client code.
-std::set<SymExpr> allocatedExpressions;
+/// All expressions that we have passed to client code, with the number of
+/// references that client code may still hold (see _sym_release).
+///
+/// The map can grow very large, so we never destroy it; this keeps program
+/// exit fast, and the memory is released with the process anyway.
+std::map<SymExpr, size_t> &allocatedExpressions =
+    *new std::map<SymExpr, size_t>;
 
-SymExpr registerExpression(SymExpr expr) {
-  if (allocatedExpressions.count(expr) == 0) {
-    // We don't know this expression yet. Record it and increase the reference
-    // counter.
-    allocatedExpressions.insert(expr);
-    Z3_inc_ref(g_context, expr);
-  }
+//
+// Pruning of hot code
+//
+// This is our equivalent of QSYM's basic-block pruning: we count how often each
+// basic block executes in a given calling context, and we only build symbolic
+// expressions on executions whose count is a power of two. On all other
+// executions, new expressions are replaced with their concrete values, so
+// constraints from hot loops become trivial and never reach the solver.
+//
 
-  return expr;
+/// The hash of the current call stack.
+size_t g_call_stack_hash = 0;
+
+/// The call-stack hashes of the callers, one per active call.
+std::vector<size_t> g_call_stack_hashes;
+
+/// Execution counts per basic block and call stack.
+std::unordered_map<size_t, uint32_t> g_site_counts;
+
+/// Do we build symbolic expressions in the current basic block?
+bool g_site_interesting = true;
+
+size_t hashCombine(size_t hash, uintptr_t value) {
+  return hash ^ (value + 0x9e3779b9 + (hash << 6) + (hash >> 2));
 }
 
-} // namespace
+/// Replace an expression with its value under the current concrete input.
+SymExpr concretize(SymExpr expr) {
+  if (Z3_is_numeral_ast(g_context, expr))
+    return expr;
 
-void _sym_initialize(void) {
-  if (g_initialized.test_and_set())
-    return;
+  // Model evaluation resets Z3's reference to the last result, which may be
+  // the only thing keeping the expression alive.
+  Z3_inc_ref(g_context, expr);
+  Z3_ast value;
+  bool success = Z3_model_eval(g_context, g_input_model, expr,
+                               /* model_completion */ true, &value);
+  Z3_dec_ref(g_context, expr);
 
-#ifndef NDEBUG
-  std::cerr << "Initializing symbolic runtime" << std::endl;
-#endif
+  return success ? value : expr;
+}
 
-  loadConfig();
-  initLibcWrappers();
-  std::cerr << "This is SymCC running with the simple backend" << std::endl
-            << "For anything but debugging SymCC itself, you will want to use "
-               "the QSYM backend instead (see README.md for build instructions)"
-            << std::endl;
+SymExpr registerExpression(SymExpr expr) {
+  if (g_profiling)
+    profileExpression();
+
+  if (!g_site_interesting)
+    expr = concretize(expr);
 
+  auto [it, inserted] = allocatedExpressions.try_emplace(expr, 0);
+  if (inserted) {
+    // We don't know this expression yet. Increase Z3's reference counter, so
+    // that the expression stays alive while client code may use it.
+    Z3_inc_ref(g_context, expr);
+  }
+  it->second++;
+
+  return expr;
+}
+
+/// Set up Z3.
+///
+/// We defer this until the program reads its first symbolic input byte:
+/// without symbolic input, the program never builds expressions, so runs that
+/// don't get to the point of reading input (or don't have any) don't pay for
+/// solver setup.
+void initSolver() {
   Z3_config cfg;
 
   cfg = Z3_mk_config();
@@ -150,6 +274,56 @@ void _sym_initialize(void) {
   g_false = Z3_mk_false(g_context);
   Z3_inc_ref(g_context, g_false);
 
+  g_input_model = Z3_mk_model(g_context);
+  Z3_model_inc_ref(g_context, g_input_model);
+
+  if (g_config.inputArray) {
+    auto *indexSort = Z3_mk_bv_sort(g_context, 64);
+    Z3_inc_ref(g_context, (Z3_ast)indexSort);
+    auto *byteSort = Z3_mk_bv_sort(g_context, 8);
+    Z3_inc_ref(g_context, (Z3_ast)byteSort);
+    g_input_array =
+        Z3_mk_const(g_context, Z3_mk_string_symbol(g_context, "stdin"),
+                    Z3_mk_array_sort(g_context, indexSort, byteSort));
+    Z3_inc_ref(g_context, g_input_array);
+
+    // In the input model, the array is backed by a function that we extend
+    // with each new input byte.
+    auto *inputFunction = Z3_mk_fresh_func_decl(g_context, "stdin", 1,
+                                                &indexSort, byteSort);
+    Z3_inc_ref(g_context, Z3_func_decl_to_ast(g_context, inputFunction));
+    g_input_interp = Z3_add_func_interp(g_context, g_input_model, inputFunction,
+                                        Z3_mk_int(g_context, 0, byteSort));
+    Z3_func_interp_inc_ref(g_context, g_input_interp);
+    Z3_add_const_interp(
+        g_context, g_input_model,
+        Z3_get_app_decl(g_context, Z3_to_app(g_context, g_input_array)),
+        Z3_mk_as_array(g_context, inputFunction));
+    Z3_dec_ref(g_context, (Z3_ast)byteSort);
+    Z3_dec_ref(g_context, (Z3_ast)indexSort);
+  }
+}
+
+} // namespace
+
+void _sym_initialize(void) {
+  if (g_initialized.test_and_set())
+    return;
+
+#ifndef NDEBUG
+  std::cerr << "Initializing symbolic runtime" << std::endl;
+#endif
+
+  loadConfig();
+  initProfiler();
+  initTracing();
+  initConcretization();
+  initLibcWrappers();
+  std::cerr << "This is SymCC running with the simple backend" << std::endl
+            << "For anything but debugging SymCC itself, you will want to use "
+               "the QSYM backend instead (see README.md for build instructions)"
+            << std::endl;
+
   if (g_config.logFile.empty()) {
     g_log = stderr;
   } else {
@@ -180,21 +354,64 @@ Z3_ast _sym_build_float(double value, int is_double) {
   return result;
 }
 
-Z3_ast _sym_get_input_byte(size_t offset, uint8_t) {
-  static std::vector<SymExpr> stdinBytes;
-
-  if (offset < stdinBytes.size())
-    return stdinBytes[offset];
+Z3_ast _sym_get_input_byte(size_t offset, uint8_t value) {
+  if (g_context == nullptr)
+    initSolver();
+
+  // Not all input bytes are necessarily symbolic (see SYMCC_SYMBOLIC_RANGES),
+  // so there may be gaps; we name each variable after its input offset.
+  if (offset < g_input_bytes.size() && g_input_bytes[offset] != nullptr)
+    return g_input_bytes[offset];
+
+  if (g_config.inputArray) {
+    auto *indexSort = Z3_mk_bv_sort(g_context, 64);
+    Z3_inc_ref(g_context, (Z3_ast)indexSort);
+    auto *byteSort = Z3_mk_bv_sort(g_context, 8);
+    Z3_inc_ref(g_context, (Z3_ast)byteSort);
+    auto *index = Z3_mk_unsigned_int64(g_context, offset, indexSort);
+    Z3_inc_ref(g_context, index);
+    auto *var = Z3_mk_select(g_context, g_input_array, index);
+    Z3_inc_ref(g_context, var);
+
+    auto args = Z3_mk_ast_vector(g_context);
+    Z3_ast_vector_inc_ref(g_context, args);
+    Z3_ast_vector_push(g_context, args, index);
+    Z3_func_interp_add_entry(
+        g_context, g_input_interp, args,
+        Z3_mk_unsigned_int64(g_context, value, byteSort));
+    Z3_ast_vector_dec_ref(g_context, args);
+
+    Z3_dec_ref(g_context, index);
+    Z3_dec_ref(g_context, (Z3_ast)byteSort);
+    Z3_dec_ref(g_context, (Z3_ast)indexSort);
+
+    if (g_input_bytes.size() <= offset)
+      g_input_bytes.resize(offset + 1);
+    g_input_bytes[offset] = var;
+    return var;
+  }
 
-  auto varName = "stdin" + std::to_string(stdinBytes.size());
+  auto varName = "stdin" + std::to_string(offset);
   auto *var = build_variable(varName.c_str(), 8);
 
-  stdinBytes.resize(offset);
-  stdinBytes.push_back(var);
+  auto *byteSort = Z3_mk_bv_sort(g_context, 8);
+  Z3_inc_ref(g_context, (Z3_ast)byteSort);
+  Z3_add_const_interp(g_context, g_input_model,
+                      Z3_get_app_decl(g_context, Z3_to_app(g_context, var)),
+                      Z3_mk_unsigned_int64(g_context, value, byteSort));
+  Z3_dec_ref(g_context, (Z3_ast)byteSort);
+
+  if (g_input_bytes.size() <= offset)
+    g_input_bytes.resize(offset + 1);
+  g_input_bytes[offset] = var;
 
   return var;
 }
 
+void _sym_record_input_bytes(size_t, const uint8_t *, size_t) {
+  // We only log solutions, which don't mention concrete input bytes.
+}
+
 Z3_ast _sym_build_null_pointer(void) { return g_null_pointer; }
 Z3_ast _sym_build_true(void) { return g_true; }
 Z3_ast _sym_build_false(void) { return g_false; }
@@ -432,10 +649,13 @@ Z3_ast _sym_build_bool_to_bit(Z3_ast expr) {
 }
 
 void _sym_push_path_constraint(Z3_ast constraint, int taken,
-                               uintptr_t site_id [[maybe_unused]]) {
+                               uintptr_t site_id) {
   if (constraint == nullptr)
     return;
 
+  if (g_profiling)
+    profilePathConstraint(site_id);
+
   constraint = Z3_simplify(g_context, constraint);
   Z3_inc_ref(g_context, constraint);
 
@@ -465,12 +685,33 @@ void _sym_push_path_constraint(Z3_ast constraint, int taken,
   fprintf(g_log, "Trying to solve:\n%s\n",
           Z3_solver_to_string(g_context, g_solver));
 
-  Z3_lbool feasible = Z3_solver_check(g_context, g_solver);
+  auto queryStart = std::chrono::steady_clock::now();
+  Z3_lbool feasible;
+  {
+    TraceScope trace(TraceEvent::SolverQuery, site_id);
+    feasible = Z3_solver_check(g_context, g_solver);
+  }
+  if (g_profiling) {
+    auto queryTime = std::chrono::steady_clock::now() - queryStart;
+    profileQuery(site_id,
+                 (feasible == Z3_L_TRUE)    ? QueryResult::Sat
+                 : (feasible == Z3_L_FALSE) ? QueryResult::Unsat
+                                            : QueryResult::Unknown,
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(queryTime)
+                     .count());
+  }
+
   if (feasible == Z3_L_TRUE) {
     Z3_model model = Z3_solver_get_model(g_context, g_solver);
     Z3_model_inc_ref(g_context, model);
-    fprintf(g_log, "Found diverging input:\n%s\n",
-            Z3_model_to_string(g_context, model));
+    if (g_config.inputArray) {
+      fprintf(g_log, "Found diverging input:\n");
+      printInputArrayModel(model);
+      fprintf(g_log, "\n");
+    } else {
+      fprintf(g_log, "Found diverging input:\n%s\n",
+              Z3_model_to_string(g_context, model));
+    }
     Z3_model_dec_ref(g_context, model);
   } else {
     fprintf(g_log, "Can't find a diverging input at this point\n");
@@ -489,6 +730,18 @@ void _sym_push_path_constraint(Z3_ast constraint, int taken,
   Z3_dec_ref(g_context, not_constraint);
 }
 
+void _sym_assert_constraint(Z3_ast constraint) {
+  if (constraint == nullptr)
+    return;
+
+  constraint = Z3_simplify(g_context, constraint);
+  Z3_inc_ref(g_context, constraint);
+  Z3_solver_assert(g_context, g_solver, constraint);
+  assert((Z3_solver_check(g_context, g_solver) == Z3_L_TRUE) &&
+         "Asserting infeasible constraint");
+  Z3_dec_ref(g_context, constraint);
+}
+
 SymExpr _sym_concat_helper(SymExpr a, SymExpr b) {
   return registerExpression(Z3_mk_concat(g_context, a, b));
 }
@@ -506,10 +759,45 @@ size_t _sym_bits_helper(SymExpr expr) {
   return result;
 }
 
-/* No call-stack tracing */
-void _sym_notify_call(uintptr_t) {}
-void _sym_notify_ret(uintptr_t) {}
-void _sym_notify_basic_block(uintptr_t) {}
+/* Call-stack tracing (only needed for pruning) */
+void _sym_notify_call(uintptr_t site_id) {
+  if (g_concretizing)
+    concretizationCall(site_id);
+
+  if (!g_config.pruning)
+    return;
+
+  g_call_stack_hashes.push_back(g_call_stack_hash);
+  g_call_stack_hash = hashCombine(g_call_stack_hash, site_id);
+}
+
+void _sym_notify_ret(uintptr_t site_id) {
+  // After the return, expressions belong to the call site again.
+  if (g_profiling)
+    profileSite(site_id);
+
+  if (g_concretizing)
+    concretizationRet(site_id, __builtin_frame_address(0));
+
+  if (!g_config.pruning || g_call_stack_hashes.empty())
+    return;
+
+  g_call_stack_hash = g_call_stack_hashes.back();
+  g_call_stack_hashes.pop_back();
+}
+
+void _sym_notify_basic_block(uintptr_t site_id) {
+  if (g_profiling)
+    profileSite(site_id);
+
+  if (!g_config.pruning)
+    return;
+
+  // Exponential back-off: build expressions on the 1st, 2nd, 4th, 8th, ...
+  // execution of the block in the current context.
+  auto count = ++g_site_counts[hashCombine(g_call_stack_hash, site_id)];
+  g_site_interesting = ((count & (count - 1)) == 0);
+}
 
 /* Debugging */
 const char *_sym_expr_to_string(SymExpr expr) {
@@ -534,6 +822,8 @@ void _sym_collect_garbage() {
   if (allocatedExpressions.size() < g_config.garbageCollectionThreshold)
     return;
 
+  TraceScope trace(TraceEvent::GarbageCollection, allocatedExpressions.size());
+
 #ifndef NDEBUG
   auto start = std::chrono::high_resolution_clock::now();
   auto startSize = allocatedExpressions.size();
@@ -542,7 +832,7 @@ void _sym_collect_garbage() {
   auto reachableExpressions = collectReachableExpressions();
   for (auto expr_it = allocatedExpressions.begin();
        expr_it != allocatedExpressions.end();) {
-    if (reachableExpressions.count(*expr_it) == 0) {
+    if (reachableExpressions.count(expr_it->first) == 0) {
       expr_it = allocatedExpressions.erase(expr_it);
     } else {
       ++expr_it;
@@ -563,6 +853,17 @@ void _sym_collect_garbage() {
 #endif
 }
 
+void _sym_release(Z3_ast expr) {
+  auto it = allocatedExpressions.find(expr);
+  if (it == allocatedExpressions.end() || --it->second > 0)
+    return;
+
+  // Nobody references the expression anymore (except, possibly, other
+  // expressions, which have their own references in Z3).
+  allocatedExpressions.erase(it);
+  Z3_dec_ref(g_context, expr);
+}
+
 /* Test-case handling */
 void symcc_set_test_case_handler(TestCaseHandler) {
   // The simple backend doesn't support test-case handlers. However, let's not
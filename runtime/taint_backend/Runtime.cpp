@@ -0,0 +1,525 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the SymCC runtime. If not, see <https://www.gnu.org/licenses/>.
+
+//
+// A byte-level taint-tracking backend.
+//
+// Instead of building symbolic expressions, we track for each value the set of
+// input offsets that it depends on; operations simply compute the union of
+// their operands' label sets. Whenever the program branches on a tainted value,
+// we record the branch site together with the input bytes that influence it,
+// and at exit we write a report. This is much cheaper than concolic execution
+// and tells us whether a full run with another backend is likely to be
+// worthwhile, and which parts of the input matter (see SYMCC_SYMBOLIC_RANGES).
+//
+// Label sets are bitsets over a window of the input, so values that depend on a
+// few nearby bytes stay small. Values without labels (i.e., constants) don't
+// need any memory: like in the no-op backend, we encode their width in a tagged
+// pointer.
+//
+
+#include <Runtime.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "Concretization.h"
+#include "Config.h"
+#include "GarbageCollection.h"
+#include "LibcWrappers.h"
+#include "Profiler.h"
+#include "SiteTable.h"
+#include "Tracing.h"
+
+/// A value that depends on (part of) the input.
+struct TaintExpr {
+  /// The width of the value.
+  size_t bits;
+
+  /// The index of the first 64-bit word of the label bitset.
+  size_t firstWord;
+
+  /// The label bitset: bit i of words[j] represents input offset
+  /// (firstWord + j) * 64 + i.
+  std::vector<uint64_t> words;
+};
+
+namespace {
+
+/// Indicate whether the runtime has been initialized.
+std::atomic_flag g_initialized = ATOMIC_FLAG_INIT;
+
+/// All label sets that we have allocated (except for input bytes).
+///
+/// We never destroy the set, so that program exit doesn't have to walk it.
+std::unordered_set<TaintExpr *> &g_allocated_expressions =
+    *new std::unordered_set<TaintExpr *>;
+
+/// The expressions for individual input bytes, indexed by offset.
+std::vector<TaintExpr *> g_input_bytes;
+
+/// The input bytes that each branch site depends on, and how often we've seen
+/// the site branch on tainted data.
+struct SiteTaint {
+  uint64_t count = 0;
+  std::vector<uint64_t> words;
+};
+
+std::map<uintptr_t, SiteTaint> g_site_taint;
+
+bool isUntainted(SymExpr expr) {
+  return (expr == nullptr) || (reinterpret_cast<uintptr_t>(expr) & 1);
+}
+
+/// Create an untainted value of the given width.
+SymExpr untainted(size_t bits) {
+  if (g_profiling)
+    profileExpression();
+
+  return reinterpret_cast<SymExpr>((static_cast<uintptr_t>(bits) << 1) | 1);
+}
+
+size_t bitsOf(SymExpr expr) {
+  return isUntainted(expr) ? (reinterpret_cast<uintptr_t>(expr) >> 1)
+                           : expr->bits;
+}
+
+SymExpr registerExpression(TaintExpr *expr) {
+  if (g_profiling)
+    profileExpression();
+
+  g_allocated_expressions.insert(expr);
+  return expr;
+}
+
+/// Does a contain all labels of b?
+bool subsumes(const TaintExpr *a, const TaintExpr *b) {
+  for (size_t i = 0; i < b->words.size(); i++) {
+    auto word = b->firstWord + i;
+    uint64_t aWord = (word >= a->firstWord &&
+                      word < a->firstWord + a->words.size())
+                         ? a->words[word - a->firstWord]
+                         : 0;
+    if ((aWord & b->words[i]) != b->words[i])
+      return false;
+  }
+
+  return true;
+}
+
+/// Create a value of the given width with the labels of expr.
+SymExpr withWidth(SymExpr expr, size_t bits) {
+  if (isUntainted(expr))
+    return untainted(bits);
+  if (expr->bits == bits)
+    return expr;
+
+  return registerExpression(new TaintExpr{bits, expr->firstWord, expr->words});
+}
+
+/// Create a value of the given width with the union of the labels of a and b.
+SymExpr merge(SymExpr a, SymExpr b, size_t bits) {
+  if (isUntainted(b))
+    return withWidth(a, bits);
+  if (isUntainted(a))
+    return withWidth(b, bits);
+
+  // Avoid allocating if one operand already has all the labels.
+  if (subsumes(a, b))
+    return withWidth(a, bits);
+  if (subsumes(b, a))
+    return withWidth(b, bits);
+
+  auto firstWord = std::min(a->firstWord, b->firstWord);
+  auto endWord = std::max(a->firstWord + a->words.size(),
+                          b->firstWord + b->words.size());
+  std::vector<uint64_t> words(endWord - firstWord);
+  for (size_t i = 0; i < a->words.size(); i++)
+    words[a->firstWord - firstWord + i] |= a->words[i];
+  for (size_t i = 0; i < b->words.size(); i++)
+    words[b->firstWord - firstWord + i] |= b->words[i];
+
+  return registerExpression(new TaintExpr{bits, firstWord, std::move(words)});
+}
+
+/// Format a label bitset as a list of offset ranges (e.g., "0-3,7").
+std::string formatLabels(const std::vector<uint64_t> &words) {
+  std::string result;
+  size_t totalBits = words.size() * 64;
+  for (size_t offset = 0; offset < totalBits;) {
+    if ((words[offset / 64] & (uint64_t(1) << (offset % 64))) == 0) {
+      offset++;
+      continue;
+    }
+
+    auto start = offset;
+    while (offset < totalBits &&
+           (words[offset / 64] & (uint64_t(1) << (offset % 64))) != 0)
+      offset++;
+
+    if (!result.empty())
+      result += ",";
+    result += std::to_string(start);
+    if (offset - 1 > start)
+      result += "-" + std::to_string(offset - 1);
+  }
+
+  return result;
+}
+
+void addLabels(std::vector<uint64_t> &words, const TaintExpr *expr) {
+  if (words.size() < expr->firstWord + expr->words.size())
+    words.resize(expr->firstWord + expr->words.size());
+  for (size_t i = 0; i < expr->words.size(); i++)
+    words[expr->firstWord + i] |= expr->words[i];
+}
+
+void writeReport() {
+  FILE *out = stderr;
+  if (!g_config.taintReportFile.empty()) {
+    out = fopen(g_config.taintReportFile.c_str(), "w");
+    if (out == nullptr) {
+      fprintf(stderr, "Failed to open the taint report %s\n",
+              g_config.taintReportFile.c_str());
+      return;
+    }
+  }
+
+  std::vector<uint64_t> allLabels;
+  for (const auto &[siteId, taint] : g_site_taint) {
+    if (allLabels.size() < taint.words.size())
+      allLabels.resize(taint.words.size());
+    for (size_t i = 0; i < taint.words.size(); i++)
+      allLabels[i] |= taint.words[i];
+  }
+
+  fprintf(out, "# tainted branch sites: %zu\n", g_site_taint.size());
+  fprintf(out, "# input bytes influencing branches: %s\n",
+          formatLabels(allLabels).c_str());
+  fprintf(out, "# site\tlocation\tcount\tinput bytes\n");
+  for (const auto &[siteId, taint] : g_site_taint) {
+    const auto *info = lookupSite(siteId);
+    fprintf(out, "%lu\t%s:%u\t%llu\t%s\n", (unsigned long)siteId,
+            (info != nullptr && info->file != nullptr) ? info->file : "??",
+            (info != nullptr) ? info->line : 0,
+            (unsigned long long)taint.count, formatLabels(taint.words).c_str());
+  }
+
+  if (out != stderr)
+    fclose(out);
+}
+
+} // namespace
+
+void _sym_initialize(void) {
+  if (g_initialized.test_and_set())
+    return;
+
+  loadConfig();
+  initProfiler();
+  initTracing();
+  initConcretization();
+  initLibcWrappers();
+  fprintf(stderr, "This is SymCC running with the taint backend\n");
+
+  atexit(writeReport);
+}
+
+//
+// Construction of simple values
+//
+
+SymExpr _sym_build_integer(uint64_t, uint8_t bits) { return untainted(bits); }
+SymExpr _sym_build_integer128(uint64_t, uint64_t) { return untainted(128); }
+
+SymExpr _sym_build_float(double, int is_double) {
+  return untainted(is_double ? 64 : 32);
+}
+
+SymExpr _sym_build_null_pointer(void) {
+  return untainted(8 * sizeof(void *));
+}
+
+SymExpr _sym_build_true(void) { return untainted(1); }
+SymExpr _sym_build_false(void) { return untainted(1); }
+SymExpr _sym_build_bool(bool) { return untainted(1); }
+
+//
+// Binary operations
+//
+
+#define DEF_SAME_WIDTH_BUILDER(name)                                           \
+  SymExpr _sym_build_##name(SymExpr a, SymExpr b) {                            \
+    return merge(a, b, bitsOf(a));                                             \
+  }
+
+DEF_SAME_WIDTH_BUILDER(add)
+DEF_SAME_WIDTH_BUILDER(sub)
+DEF_SAME_WIDTH_BUILDER(mul)
+DEF_SAME_WIDTH_BUILDER(unsigned_div)
+DEF_SAME_WIDTH_BUILDER(signed_div)
+DEF_SAME_WIDTH_BUILDER(unsigned_rem)
+DEF_SAME_WIDTH_BUILDER(signed_rem)
+DEF_SAME_WIDTH_BUILDER(shift_left)
+DEF_SAME_WIDTH_BUILDER(logical_shift_right)
+DEF_SAME_WIDTH_BUILDER(arithmetic_shift_right)
+DEF_SAME_WIDTH_BUILDER(and)
+DEF_SAME_WIDTH_BUILDER(or)
+DEF_SAME_WIDTH_BUILDER(xor)
+DEF_SAME_WIDTH_BUILDER(bool_and)
+DEF_SAME_WIDTH_BUILDER(bool_or)
+DEF_SAME_WIDTH_BUILDER(bool_xor)
+DEF_SAME_WIDTH_BUILDER(fp_add)
+DEF_SAME_WIDTH_BUILDER(fp_sub)
+DEF_SAME_WIDTH_BUILDER(fp_mul)
+DEF_SAME_WIDTH_BUILDER(fp_div)
+DEF_SAME_WIDTH_BUILDER(fp_rem)
+
+#undef DEF_SAME_WIDTH_BUILDER
+
+#define DEF_COMPARISON_BUILDER(name)                                           \
+  SymExpr _sym_build_##name(SymExpr a, SymExpr b) { return merge(a, b, 1); }
+
+DEF_COMPARISON_BUILDER(signed_less_than)
+DEF_COMPARISON_BUILDER(signed_less_equal)
+DEF_COMPARISON_BUILDER(signed_greater_than)
+DEF_COMPARISON_BUILDER(signed_greater_equal)
+DEF_COMPARISON_BUILDER(unsigned_less_than)
+DEF_COMPARISON_BUILDER(unsigned_less_equal)
+DEF_COMPARISON_BUILDER(unsigned_greater_than)
+DEF_COMPARISON_BUILDER(unsigned_greater_equal)
+DEF_COMPARISON_BUILDER(equal)
+DEF_COMPARISON_BUILDER(not_equal)
+DEF_COMPARISON_BUILDER(float_ordered_greater_than)
+DEF_COMPARISON_BUILDER(float_ordered_greater_equal)
+DEF_COMPARISON_BUILDER(float_ordered_less_than)
+DEF_COMPARISON_BUILDER(float_ordered_less_equal)
+DEF_COMPARISON_BUILDER(float_ordered_equal)
+DEF_COMPARISON_BUILDER(float_ordered_not_equal)
+DEF_COMPARISON_BUILDER(float_ordered)
+DEF_COMPARISON_BUILDER(float_unordered)
+DEF_COMPARISON_BUILDER(float_unordered_greater_than)
+DEF_COMPARISON_BUILDER(float_unordered_greater_equal)
+DEF_COMPARISON_BUILDER(float_unordered_less_than)
+DEF_COMPARISON_BUILDER(float_unordered_less_equal)
+DEF_COMPARISON_BUILDER(float_unordered_equal)
+DEF_COMPARISON_BUILDER(float_unordered_not_equal)
+
+#undef DEF_COMPARISON_BUILDER
+
+//
+// Unary operations and casts
+//
+
+SymExpr _sym_build_neg(SymExpr expr) { return expr; }
+SymExpr _sym_build_not(SymExpr expr) { return expr; }
+SymExpr _sym_build_fp_abs(SymExpr a) { return a; }
+SymExpr _sym_build_fp_neg(SymExpr a) { return a; }
+
+SymExpr _sym_build_ite(SymExpr cond, SymExpr a, SymExpr b) {
+  // The result depends on the condition as well as on both alternatives.
+  return merge(merge(cond, a, bitsOf(a)), b, bitsOf(a));
+}
+
+SymExpr _sym_build_sext(SymExpr expr, uint8_t bits) {
+  if (expr == nullptr)
+    return nullptr;
+  return withWidth(expr, bitsOf(expr) + bits);
+}
+
+SymExpr _sym_build_zext(SymExpr expr, uint8_t bits) {
+  if (expr == nullptr)
+    return nullptr;
+  return withWidth(expr, bitsOf(expr) + bits);
+}
+
+SymExpr _sym_build_trunc(SymExpr expr, uint8_t bits) {
+  if (expr == nullptr)
+    return nullptr;
+  return withWidth(expr, bits);
+}
+
+SymExpr _sym_build_int_to_float(SymExpr value, int is_double, int) {
+  return withWidth(value, is_double ? 64 : 32);
+}
+
+SymExpr _sym_build_float_to_float(SymExpr expr, int to_double) {
+  return withWidth(expr, to_double ? 64 : 32);
+}
+
+SymExpr _sym_build_bits_to_float(SymExpr expr, int to_double) {
+  if (expr == nullptr)
+    return nullptr;
+  return withWidth(expr, to_double ? 64 : 32);
+}
+
+SymExpr _sym_build_float_to_bits(SymExpr expr) {
+  if (expr == nullptr)
+    return nullptr;
+  return expr;
+}
+
+SymExpr _sym_build_float_to_signed_integer(SymExpr expr, uint8_t bits) {
+  return withWidth(expr, bits);
+}
+
+SymExpr _sym_build_float_to_unsigned_integer(SymExpr expr, uint8_t bits) {
+  return withWidth(expr, bits);
+}
+
+SymExpr _sym_build_bool_to_bit(SymExpr expr) {
+  if (expr == nullptr)
+    return nullptr;
+  return withWidth(expr, 1);
+}
+
+//
+// Bit-array helpers
+//
+
+SymExpr _sym_concat_helper(SymExpr a, SymExpr b) {
+  return merge(a, b, bitsOf(a) + bitsOf(b));
+}
+
+SymExpr _sym_extract_helper(SymExpr expr, size_t first_bit, size_t last_bit) {
+  // We track labels per value, not per bit, so extracting a byte from a value
+  // keeps all of its labels. Since memory is shadowed byte by byte, precision
+  // is only lost for values computed from several input bytes.
+  return withWidth(expr, first_bit - last_bit + 1);
+}
+
+size_t _sym_bits_helper(SymExpr expr) { return bitsOf(expr); }
+
+//
+// Constraint handling
+//
+
+void _sym_push_path_constraint(SymExpr constraint, int, uintptr_t site_id) {
+  if (isUntainted(constraint))
+    return;
+
+  if (g_profiling)
+    profilePathConstraint(site_id);
+
+  auto &taint = g_site_taint[site_id];
+  taint.count++;
+  addLabels(taint.words, constraint);
+}
+
+void _sym_assert_constraint(SymExpr) {
+  // Only branches count as uses of the input.
+}
+
+SymExpr _sym_get_input_byte(size_t offset, uint8_t) {
+  if (offset < g_input_bytes.size() && g_input_bytes[offset] != nullptr)
+    return g_input_bytes[offset];
+
+  // Input bytes live for the entire execution, so we don't register them with
+  // the garbage collector.
+  std::vector<uint64_t> words{uint64_t(1) << (offset % 64)};
+  auto *expr = new TaintExpr{8, offset / 64, std::move(words)};
+  if (g_input_bytes.size() <= offset)
+    g_input_bytes.resize(offset + 1);
+  g_input_bytes[offset] = expr;
+
+  return expr;
+}
+
+void _sym_record_input_bytes(size_t, const uint8_t *, size_t) {
+  // Concrete bytes don't carry taint.
+}
+
+//
+// Call-stack tracing
+//
+
+void _sym_notify_call(uintptr_t site_id) {
+  if (g_concretizing)
+    concretizationCall(site_id);
+}
+
+void _sym_notify_ret(uintptr_t site_id) {
+  if (g_profiling)
+    profileSite(site_id);
+
+  if (g_concretizing)
+    concretizationRet(site_id, __builtin_frame_address(0));
+}
+
+void _sym_notify_basic_block(uintptr_t site_id) {
+  if (g_profiling)
+    profileSite(site_id);
+}
+
+//
+// Debugging
+//
+
+const char *_sym_expr_to_string(SymExpr expr) {
+  static std::string buffer;
+  buffer = std::to_string(bitsOf(expr)) + "-bit value depending on input {" +
+           (isUntainted(expr) ? std::string() : formatLabels([&] {
+             std::vector<uint64_t> words;
+             addLabels(words, expr);
+             return words;
+           }())) +
+           "}";
+  return buffer.c_str();
+}
+
+bool _sym_feasible(SymExpr) { return true; }
+
+//
+// Garbage collection
+//
+
+void _sym_collect_garbage() {
+  if (g_allocated_expressions.size() < g_config.garbageCollectionThreshold)
+    return;
+
+  TraceScope trace(TraceEvent::GarbageCollection,
+                   g_allocated_expressions.size());
+
+  auto reachableExpressions = collectReachableExpressions();
+  for (auto expr_it = g_allocated_expressions.begin();
+       expr_it != g_allocated_expressions.end();) {
+    if (reachableExpressions.count(*expr_it) == 0) {
+      delete *expr_it;
+      expr_it = g_allocated_expressions.erase(expr_it);
+    } else {
+      ++expr_it;
+    }
+  }
+}
+
+void _sym_release(SymExpr) {
+  // Values share label sets without counting references (see withWidth and
+  // merge), so we can't tell when a set is unused; the garbage collector
+  // takes care of them.
+}
+
+//
+// Test-case handling
+//
+
+void symcc_set_test_case_handler(TestCaseHandler) {
+  // We never generate test cases.
+}
@@ -0,0 +1,45 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+
+// RUN: %symcc -O2 %s -o %t
+// RUN: head -c 1024 /dev/zero | %t
+//
+// A benchmark program rather than a test: compute a checksum over the input and
+// branch on it, so that the symbolic run builds long expression chains and
+// issues a steady stream of solver queries.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  uint8_t buffer[1024];
+  ssize_t length = read(STDIN_FILENO, buffer, sizeof(buffer));
+  if (length <= 0)
+    return 1;
+
+  uint32_t sum = 0;
+  unsigned matches = 0;
+  for (ssize_t i = 0; i < length; i++) {
+    sum = (sum << 1 | sum >> 31) ^ buffer[i];
+    if (buffer[i] == 'S')
+      matches++;
+  }
+
+  if (sum == 0xdeadbeef)
+    puts("magic checksum");
+  printf("%u matches\n", matches);
+  return 0;
+}
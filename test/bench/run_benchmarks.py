@@ -0,0 +1,361 @@
+#!/usr/bin/env python3
+
+# This file is part of SymCC.
+#
+# SymCC is free software: you can redistribute it and/or modify it under the
+# terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+# WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+# A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along with
+# SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+"""End-to-end overhead benchmarks over the lit test corpus.
+
+Each program is built with plain clang and with symcc (once per backend), and
+then run via the commands in its lit RUN lines: uninstrumented, instrumented
+with SYMCC_NO_SYMBOLIC_INPUT=1, and instrumented with symbolic input. See
+docs/Benchmarking.txt for details.
+"""
+
+import argparse
+import json
+import os
+import re
+import shlex
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+# Keep in sync with test/lit.cfg.
+SUFFIXES = [".c", ".cpp", ".ll"]
+
+RUN_LINE = re.compile(r"^\s*(?://|;)\s*RUN:\s*(.*)$")
+CHECKER = re.compile(r"\|\s*(?:%filecheck|FileCheck)\b.*$")
+SEPARATOR = re.compile(r"\|\||&&|[|;&]")
+ASSIGNMENT = re.compile(r"^[A-Za-z_][A-Za-z0-9_]*=")
+
+
+def executes_program(command):
+    """Tell whether any part of the pipeline runs %t (possibly via env or with
+    variable assignments), as opposed to, e.g., just writing to %t.list."""
+    for part in SEPARATOR.split(command):
+        try:
+            words = shlex.split(part)
+        except ValueError:
+            words = part.split()
+        while words and (words[0] == "env" or ASSIGNMENT.match(words[0])):
+            words.pop(0)
+        if words and words[0] == "%t":
+            return True
+    return False
+
+
+class Program:
+    """A benchmark program and the commands from its RUN lines."""
+
+    def __init__(self, path):
+        self.path = path
+        self.name = os.path.splitext(os.path.basename(path))[0]
+        self.compile_prefix = ""
+        self.compile_args = None
+        self.setup = []
+        self.commands = []
+
+        with open(path) as source:
+            for line in source:
+                match = RUN_LINE.match(line)
+                if match is None:
+                    continue
+                command = match.group(1).strip()
+                if "%symcc" in command:
+                    if self.compile_args is None:
+                        # Keep anything before %symcc (e.g., "env VAR=..."),
+                        # so that we build with the same settings.
+                        self.compile_prefix, self.compile_args = (
+                            command.split("%symcc", 1))
+                elif executes_program(command):
+                    self.commands.append(CHECKER.sub("", command))
+                elif not CHECKER.search(command):
+                    # Commands that only prepare files (e.g., "echo ... >
+                    # %t.list") run before each build.
+                    self.setup.append(command)
+
+    def skip_reason(self):
+        if self.compile_args is None:
+            return "no compile command"
+        if re.search(r"\s-(c|S)\b", self.compile_args):
+            return "doesn't build an executable"
+        if not self.commands:
+            return "no run command"
+        return None
+
+
+def substitute(command, program, executable, temp_dir):
+    return (
+        command.replace("%basename_t", program.name)
+        .replace("%s", program.path)
+        .replace("%S", os.path.dirname(program.path))
+        .replace("%T", temp_dir)
+        .replace("%t", executable)
+    )
+
+
+def build(program, compiler, executable, temp_dir, env):
+    # Setup commands may create files named after the executable (%t.list,
+    # etc.), which the build and the runs refer to.
+    for command in program.setup:
+        subprocess.run(substitute(command, program, executable, temp_dir),
+                       shell=True, env=env, check=True, executable="/bin/bash")
+
+    prefix = substitute(program.compile_prefix, program, executable, temp_dir)
+    args = substitute(program.compile_args, program, executable, temp_dir)
+    command = "{}{} {}".format(prefix, compiler, args)
+    result = subprocess.run(
+        command, shell=True, env=env, stdout=subprocess.DEVNULL,
+        stderr=subprocess.PIPE)
+    if result.returncode != 0:
+        raise RuntimeError("Failed to build {}:\n{}".format(
+            program.path, result.stderr.decode(errors="replace")))
+
+
+def run(program, executable, temp_dir, env):
+    """Run all commands of the program; return wall time and peak RSS."""
+    wall_time = 0.0
+    peak_rss_kb = 0
+    for command in program.commands:
+        command = substitute(command, program, executable, temp_dir)
+        start = time.perf_counter()
+        process = subprocess.Popen(
+            ["/bin/bash", "-c", command], env=env,
+            stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        # The shell reaps the processes it spawns, so its resource usage covers
+        # the entire pipeline.
+        _, _, usage = os.wait4(process.pid, 0)
+        wall_time += time.perf_counter() - start
+        peak_rss_kb = max(peak_rss_kb, usage.ru_maxrss)
+    return wall_time, peak_rss_kb
+
+
+def read_profile(path):
+    """Sum up the per-site profile written by the runtime."""
+    totals = {"expressions": 0, "queries": 0, "solver_ns": 0}
+    if not os.path.exists(path):
+        return totals
+    with open(path) as profile:
+        header = None
+        for line in profile:
+            fields = line.rstrip("\n").split("\t")
+            if line.startswith("#"):
+                header = [name.strip("# ") for name in fields]
+                # Backends that can't observe individual solver queries
+                # (QSYM) leave out the query columns.
+                totals = {key: value for key, value in totals.items()
+                          if key in header}
+                continue
+            row = dict(zip(header, fields))
+            for key in totals:
+                totals[key] += int(row[key])
+    os.remove(path)
+    return totals
+
+
+def measure(program, executable, temp_dir, env, repetitions):
+    samples = [run(program, executable, temp_dir, env)
+               for _ in range(repetitions)]
+    return {
+        "wall_time_s": statistics.median(s[0] for s in samples),
+        "peak_rss_kb": max(s[1] for s in samples),
+    }
+
+
+def text_size(executable):
+    """Return the size of the executable's code in bytes (if we can tell)."""
+    if shutil.which("size") is None:
+        return None
+    result = subprocess.run(["size", executable], stdout=subprocess.PIPE,
+                            stderr=subprocess.DEVNULL)
+    if result.returncode != 0:
+        return None
+    # Berkeley format: a header line, then "text data bss dec hex filename".
+    return int(result.stdout.decode().splitlines()[1].split()[0])
+
+
+def configurations(args):
+    """Yield the backends to measure, once per requested pass position, and
+    additionally without outlining if requested."""
+    for backend, runtime_dir in args.backend:
+        for position in args.pass_position or [None]:
+            yield backend, runtime_dir, position, True
+            if args.no_outlining:
+                yield backend, runtime_dir, position, False
+
+
+def benchmark(program, args, temp_dir):
+    env = dict(os.environ)
+    plain = os.path.join(temp_dir, program.name + ".plain")
+    build(program, args.clang, plain, temp_dir, env)
+    result = {"plain": measure(program, plain, temp_dir, env, args.repeat)}
+    result["plain"]["text_bytes"] = text_size(plain)
+
+    for backend, runtime_dir, position, outlining in configurations(args):
+        name = backend if position is None else backend + "/" + position
+        if not outlining:
+            name += "/no-outlining"
+        instrumented = os.path.join(
+            temp_dir, program.name + "." + name.replace("/", "."))
+        build_env = dict(env, SYMCC_RUNTIME_DIR=runtime_dir)
+        if position is not None:
+            build_env["SYMCC_PASS_POSITION"] = position
+        if not outlining:
+            build_env["SYMCC_NO_OUTLINING"] = "1"
+        build(program, args.symcc, instrumented, temp_dir, build_env)
+
+        output_dir = os.path.join(temp_dir, "output")
+        os.makedirs(output_dir, exist_ok=True)
+        run_env = dict(env, SYMCC_OUTPUT_DIR=output_dir)
+
+        concrete = measure(program, instrumented, temp_dir,
+                           dict(run_env, SYMCC_NO_SYMBOLIC_INPUT="1"),
+                           args.repeat)
+        symbolic = measure(program, instrumented, temp_dir, run_env,
+                           args.repeat)
+
+        # Profiling slows down execution, so we collect the counters in a
+        # separate run.
+        profile = os.path.join(temp_dir, "profile.tsv")
+        run(program, instrumented, temp_dir,
+            dict(run_env, SYMCC_PROFILE_FILE=profile))
+        symbolic.update(read_profile(profile))
+
+        plain_time = result["plain"]["wall_time_s"]
+        for measurement in (concrete, symbolic):
+            measurement["overhead"] = (
+                measurement["wall_time_s"] / plain_time if plain_time > 0
+                else None)
+
+        result[name] = {"concrete": concrete, "symbolic": symbolic,
+                        "text_bytes": text_size(instrumented)}
+        shutil.rmtree(output_dir)
+
+    return result
+
+
+def compare(results, baseline, tolerance):
+    """Print changes against the baseline; return the number of regressions."""
+    regressions = 0
+    for name, result in sorted(results.items()):
+        if name not in baseline:
+            continue
+        for backend, modes in result.items():
+            if backend == "plain" or backend not in baseline[name]:
+                continue
+            for mode, measurement in modes.items():
+                if not isinstance(measurement, dict):
+                    continue
+                old = baseline[name][backend].get(mode, {}).get("overhead")
+                new = measurement.get("overhead")
+                if not old or not new:
+                    continue
+                change = new / old - 1
+                marker = ""
+                if change > tolerance:
+                    marker = "  REGRESSION"
+                    regressions += 1
+                print("{:30} {:24} {:9} overhead {:7.2f}x -> {:7.2f}x "
+                      "({:+.1%}){}".format(name, backend, mode, old, new,
+                                           change, marker))
+    return regressions
+
+
+def find_programs(paths):
+    programs = []
+    for path in paths:
+        if os.path.isdir(path):
+            for entry in sorted(os.listdir(path)):
+                if os.path.splitext(entry)[1] in SUFFIXES:
+                    programs.append(os.path.join(path, entry))
+        else:
+            programs.append(path)
+    return programs
+
+
+def parse_backend(value):
+    name, separator, runtime_dir = value.partition("=")
+    if not separator:
+        raise argparse.ArgumentTypeError(
+            "expected NAME=RUNTIME_DIR, got {}".format(value))
+    return name, runtime_dir
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--symcc", required=True, help="the symcc script")
+    parser.add_argument("--clang", required=True,
+                        help="the clang binary for uninstrumented builds")
+    parser.add_argument("--backend", action="append", type=parse_backend,
+                        required=True, metavar="NAME=RUNTIME_DIR",
+                        help="a backend to measure (may be repeated)")
+    parser.add_argument("--pass-position", action="append",
+                        choices=["vectorizer-start", "optimizer-last"],
+                        help="instrument at this point of the optimization "
+                        "pipeline (may be repeated to compare positions; see "
+                        "SYMCC_PASS_POSITION in docs/Configuration.txt)")
+    parser.add_argument("--no-outlining", action="store_true",
+                        help="also measure each configuration without "
+                        "outlining slow paths (see SYMCC_NO_OUTLINING in "
+                        "docs/Configuration.txt)")
+    parser.add_argument("--repeat", type=int, default=5,
+                        help="runs per measurement (we report the median)")
+    parser.add_argument("--output", help="write the results to this file")
+    parser.add_argument("--baseline", help="compare against these results")
+    parser.add_argument("--tolerance", type=float, default=0.1,
+                        help="relative overhead increase that counts as a "
+                        "regression")
+    parser.add_argument("programs", nargs="*",
+                        default=[os.path.dirname(here),
+                                 os.path.join(here, "programs")],
+                        help="programs or directories of programs "
+                        "(default: the lit test suite and test/bench/programs)")
+    args = parser.parse_args()
+
+    results = {}
+    with tempfile.TemporaryDirectory(prefix="symcc-bench.") as temp_dir:
+        for path in find_programs(args.programs):
+            program = Program(os.path.abspath(path))
+            reason = program.skip_reason()
+            if reason is not None:
+                print("Skipping {}: {}".format(program.name, reason),
+                      file=sys.stderr)
+                continue
+            print("Benchmarking {}".format(program.name), file=sys.stderr)
+            try:
+                results[program.name] = benchmark(program, args, temp_dir)
+            except (RuntimeError, subprocess.CalledProcessError) as error:
+                print("Skipping {}: {}".format(program.name, error),
+                      file=sys.stderr)
+
+    document = json.dumps(results, indent=2, sort_keys=True)
+    if args.output:
+        with open(args.output, "w") as output:
+            output.write(document + "\n")
+    else:
+        print(document)
+
+    if args.baseline:
+        with open(args.baseline) as baseline:
+            if compare(results, json.load(baseline), args.tolerance) > 0:
+                return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
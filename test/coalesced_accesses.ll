@@ -0,0 +1,102 @@
+; This file is part of SymCC.
+;
+; SymCC is free software: you can redistribute it and/or modify it under the
+; terms of the GNU General Public License as published by the Free Software
+; Foundation, either version 3 of the License, or (at your option) any later
+; version.
+;
+; SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+; WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+; A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+;
+; You should have received a copy of the GNU General Public License along with
+; SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+; Check that runs of adjacent loads and stores access the shadow memory
+; together without mixing up the expressions of the individual fields. We don't
+; optimize, so that the field accesses aren't combined before instrumentation.
+;
+; Since the bitcode is written by hand, we first run llc on it because it
+; performs a validity check, whereas Clang doesn't.
+;
+; RUN: llc %s -o /dev/null
+; RUN: %symcc -O0 %s -o %t
+; RUN: echo -ne "\x00\x00\x00\x00" | %t 2>&1 | %filecheck %s
+
+%struct._IO_FILE = type opaque
+%struct.fields = type { i8, i8, i16 }
+
+@stderr = external dso_local local_unnamed_addr global %struct._IO_FILE*, align 8
+@.str = private unnamed_addr constant [18 x i8] c"Failed to read x\0A\00", align 1
+@.str.1 = private unnamed_addr constant [4 x i8] c"%s\0A\00", align 1
+@.str.2 = private unnamed_addr constant [4 x i8] c"yes\00", align 1
+@.str.3 = private unnamed_addr constant [3 x i8] c"no\00", align 1
+
+define dso_local i32 @main(i32 %argc, i8** nocapture readnone %argv) local_unnamed_addr {
+entry:
+  %x = alloca %struct.fields, align 4
+  %y = alloca %struct.fields, align 4
+  %0 = bitcast %struct.fields* %x to i8*
+  %call = call i64 @read(i32 0, i8* nonnull %0, i64 4)
+  %cmp.not = icmp eq i64 %call, 4
+  %1 = load %struct._IO_FILE*, %struct._IO_FILE** @stderr, align 8
+  br i1 %cmp.not, label %if.end, label %if.then
+
+if.then:
+  %2 = call i64 @fwrite(i8* getelementptr inbounds ([18 x i8], [18 x i8]* @.str, i64 0, i64 0), i64 17, i64 1, %struct._IO_FILE* %1)
+  br label %cleanup
+
+if.end:
+  ; Copy x to y with the first two fields swapped. The stores don't alias the
+  ; loads, so both sides form a run.
+  %x.a = getelementptr inbounds %struct.fields, %struct.fields* %x, i64 0, i32 0
+  %x.b = getelementptr inbounds %struct.fields, %struct.fields* %x, i64 0, i32 1
+  %x.c = getelementptr inbounds %struct.fields, %struct.fields* %x, i64 0, i32 2
+  %y.a = getelementptr inbounds %struct.fields, %struct.fields* %y, i64 0, i32 0
+  %y.b = getelementptr inbounds %struct.fields, %struct.fields* %y, i64 0, i32 1
+  %y.c = getelementptr inbounds %struct.fields, %struct.fields* %y, i64 0, i32 2
+  %a = load i8, i8* %x.a, align 4
+  %b = load i8, i8* %x.b, align 1
+  store i8 %b, i8* %y.a, align 4
+  %c = load i16, i16* %x.c, align 2
+  store i8 %a, i8* %y.b, align 1
+  store i16 %c, i16* %y.c, align 2
+
+  ; Read the copy back field by field.
+  %ya = load i8, i8* %y.a, align 4
+  %yb = load i8, i8* %y.b, align 1
+  %yc = load i16, i16* %y.c, align 2
+  %cmp = icmp eq i8 %ya, 17
+  %cond = select i1 %cmp, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.2, i64 0, i64 0), i8* getelementptr inbounds ([3 x i8], [3 x i8]* @.str.3, i64 0, i64 0)
+  ; SIMPLE: Trying to solve
+  ; SIMPLE: Found diverging input
+  ; SIMPLE: stdin1 -> #x11
+  ; ANY: no
+  %call1 = call i32 (%struct._IO_FILE*, i8*, ...) @fprintf(%struct._IO_FILE* %1, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.1, i64 0, i64 0), i8* %cond)
+
+  %cmp2 = icmp eq i16 %yc, 8755
+  %cond2 = select i1 %cmp2, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.2, i64 0, i64 0), i8* getelementptr inbounds ([3 x i8], [3 x i8]* @.str.3, i64 0, i64 0)
+  ; SIMPLE: Trying to solve
+  ; SIMPLE: Found diverging input
+  ; SIMPLE-DAG: stdin2 -> #x33
+  ; SIMPLE-DAG: stdin3 -> #x22
+  ; ANY: no
+  %call2 = call i32 (%struct._IO_FILE*, i8*, ...) @fprintf(%struct._IO_FILE* %1, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.1, i64 0, i64 0), i8* %cond2)
+
+  %cmp3 = icmp eq i8 %yb, 34
+  %cond3 = select i1 %cmp3, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.2, i64 0, i64 0), i8* getelementptr inbounds ([3 x i8], [3 x i8]* @.str.3, i64 0, i64 0)
+  ; SIMPLE: Trying to solve
+  ; SIMPLE: Found diverging input
+  ; SIMPLE: stdin0 -> #x22
+  ; ANY: no
+  %call3 = call i32 (%struct._IO_FILE*, i8*, ...) @fprintf(%struct._IO_FILE* %1, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.1, i64 0, i64 0), i8* %cond3)
+  br label %cleanup
+
+cleanup:
+  %retval.0 = phi i32 [ -1, %if.then ], [ 0, %if.end ]
+  ret i32 %retval.0
+}
+
+declare i64 @read(i32, i8* nocapture, i64)
+declare i32 @fprintf(%struct._IO_FILE* nocapture, i8* nocapture readonly, ...)
+declare i64 @fwrite(i8* nocapture, i64, i64, %struct._IO_FILE* nocapture)
@@ -0,0 +1,118 @@
+; This file is part of SymCC.
+;
+; SymCC is free software: you can redistribute it and/or modify it under the
+; terms of the GNU General Public License as published by the Free Software
+; Foundation, either version 3 of the License, or (at your option) any later
+; version.
+;
+; SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+; WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+; A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+;
+; You should have received a copy of the GNU General Public License along with
+; SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+
+; Check that the runtime concretizes the outputs of the functions named in the
+; concretization policy: their return values and the memory that they write
+; become concrete, and with "pin" the concrete values are enforced by
+; constraints.
+;
+; Since the bitcode is written by hand, we first run llc on it because it
+; performs a validity check, whereas Clang doesn't.
+;
+; RUN: llc %s -o /dev/null
+; RUN: %symcc -O0 %s -o %t
+; RUN: printf "dig*\nchecksum pin # keep the input consistent\n" > %t.policy
+; RUN: echo -ne "\x00" | env SYMCC_CONCRETIZE_POLICY=%t.policy %t 2>&1 | %filecheck %s
+
+%struct._IO_FILE = type opaque
+
+@stderr = external dso_local local_unnamed_addr global %struct._IO_FILE*, align 8
+@g = dso_local global i8 0, align 1
+@h = dso_local global i8 0, align 1
+@.str = private unnamed_addr constant [18 x i8] c"Failed to read x\0A\00", align 1
+@.str.1 = private unnamed_addr constant [4 x i8] c"%s\0A\00", align 1
+@.str.2 = private unnamed_addr constant [4 x i8] c"yes\00", align 1
+@.str.3 = private unnamed_addr constant [3 x i8] c"no\00", align 1
+
+define dso_local i8 @digest(i8 %value) noinline {
+entry:
+  %plus = add i8 %value, 2
+  store i8 %plus, i8* @h, align 1
+  %times = mul i8 %value, 5
+  ret i8 %times
+}
+
+define dso_local i8 @checksum(i8 %value) noinline {
+entry:
+  %plus = add i8 %value, 1
+  store i8 %plus, i8* @g, align 1
+  %times = mul i8 %value, 3
+  ret i8 %times
+}
+
+define dso_local i32 @main(i32 %argc, i8** nocapture readnone %argv) local_unnamed_addr {
+entry:
+  %x = alloca i8, align 1
+  %call = call i64 @read(i32 0, i8* nonnull %x, i64 1)
+  %cmp.not = icmp eq i64 %call, 1
+  %0 = load %struct._IO_FILE*, %struct._IO_FILE** @stderr, align 8
+  br i1 %cmp.not, label %if.end, label %if.then
+
+if.then:
+  %1 = call i64 @fwrite(i8* getelementptr inbounds ([18 x i8], [18 x i8]* @.str, i64 0, i64 0), i64 17, i64 1, %struct._IO_FILE* %0)
+  br label %cleanup
+
+if.end:
+  ; Without pinning, the outputs of digest are simply concrete.
+  %v = load i8, i8* %x, align 1
+  %d = call i8 @digest(i8 %v)
+  %cmp1 = icmp eq i8 %d, 42
+  ; SIMPLE-NOT: Trying to solve
+  ; ANY: no
+  %cond1 = select i1 %cmp1, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.2, i64 0, i64 0), i8* getelementptr inbounds ([3 x i8], [3 x i8]* @.str.3, i64 0, i64 0)
+  %call1 = call i32 (%struct._IO_FILE*, i8*, ...) @fprintf(%struct._IO_FILE* %0, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.1, i64 0, i64 0), i8* %cond1)
+  %w = load i8, i8* @h, align 1
+  %cmp2 = icmp eq i8 %w, 7
+  ; SIMPLE-NOT: Trying to solve
+  ; ANY: no
+  %cond2 = select i1 %cmp2, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.2, i64 0, i64 0), i8* getelementptr inbounds ([3 x i8], [3 x i8]* @.str.3, i64 0, i64 0)
+  %call2 = call i32 (%struct._IO_FILE*, i8*, ...) @fprintf(%struct._IO_FILE* %0, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.1, i64 0, i64 0), i8* %cond2)
+
+  ; The input itself is still symbolic.
+  %cmp3 = icmp eq i8 %v, 9
+  ; SIMPLE: Trying to solve
+  ; SIMPLE: Found diverging input
+  ; SIMPLE: stdin0 -> #x09
+  ; ANY: no
+  %cond3 = select i1 %cmp3, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.2, i64 0, i64 0), i8* getelementptr inbounds ([3 x i8], [3 x i8]* @.str.3, i64 0, i64 0)
+  %call3 = call i32 (%struct._IO_FILE*, i8*, ...) @fprintf(%struct._IO_FILE* %0, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.1, i64 0, i64 0), i8* %cond3)
+
+  ; With pinning, the runtime fixes the outputs of checksum without asking the
+  ; solver for an input that changes them...
+  %r = call i8 @checksum(i8 %v)
+  ; SIMPLE-NOT: Trying to solve
+  %cmp4 = icmp eq i8 %r, 42
+  ; SIMPLE-NOT: Trying to solve
+  ; ANY: no
+  %cond4 = select i1 %cmp4, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.2, i64 0, i64 0), i8* getelementptr inbounds ([3 x i8], [3 x i8]* @.str.3, i64 0, i64 0)
+  %call4 = call i32 (%struct._IO_FILE*, i8*, ...) @fprintf(%struct._IO_FILE* %0, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.1, i64 0, i64 0), i8* %cond4)
+
+  ; ...and afterwards the input can't change anymore.
+  %cmp5 = icmp eq i8 %v, 9
+  ; SIMPLE: Trying to solve
+  ; SIMPLE: Can't find a diverging input
+  ; ANY: no
+  %cond5 = select i1 %cmp5, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.2, i64 0, i64 0), i8* getelementptr inbounds ([3 x i8], [3 x i8]* @.str.3, i64 0, i64 0)
+  %call5 = call i32 (%struct._IO_FILE*, i8*, ...) @fprintf(%struct._IO_FILE* %0, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.1, i64 0, i64 0), i8* %cond5)
+  br label %cleanup
+
+cleanup:
+  %retval.0 = phi i32 [ -1, %if.then ], [ 0, %if.end ]
+  ret i32 %retval.0
+}
+
+declare i64 @read(i32, i8* nocapture, i64)
+declare i32 @fprintf(%struct._IO_FILE* nocapture, i8* nocapture readonly, ...)
+declare i64 @fwrite(i8* nocapture, i64, i64, %struct._IO_FILE* nocapture)
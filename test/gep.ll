@@ -0,0 +1,88 @@
+; This file is part of SymCC.
+;
+; SymCC is free software: you can redistribute it and/or modify it under the
+; terms of the GNU General Public License as published by the Free Software
+; Foundation, either version 3 of the License, or (at your option) any later
+; version.
+;
+; SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+; WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+; A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+;
+; You should have received a copy of the GNU General Public License along with
+; SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+; Check the symbolic address computation of GEPs with symbolic and constant
+; indices. We don't optimize, so that the address arithmetic stays in the GEPs.
+;
+; Since the bitcode is written by hand, we first run llc on it because it
+; performs a validity check, whereas Clang doesn't.
+;
+; RUN: llc %s -o /dev/null
+; RUN: %symcc -O0 %s -o %t
+; RUN: echo -ne "\x00\x00" | %t 2>&1 | %filecheck %s
+
+%struct._IO_FILE = type opaque
+%struct.entry = type { i32, [4 x i16] }
+
+@stderr = external dso_local local_unnamed_addr global %struct._IO_FILE*, align 8
+@table = dso_local global [8 x %struct.entry] zeroinitializer, align 16
+@.str = private unnamed_addr constant [18 x i8] c"Failed to read x\0A\00", align 1
+@.str.1 = private unnamed_addr constant [4 x i8] c"%s\0A\00", align 1
+@.str.2 = private unnamed_addr constant [4 x i8] c"yes\00", align 1
+@.str.3 = private unnamed_addr constant [3 x i8] c"no\00", align 1
+
+define dso_local i32 @main(i32 %argc, i8** nocapture readnone %argv) local_unnamed_addr {
+entry:
+  %x = alloca [2 x i8], align 1
+  %0 = getelementptr inbounds [2 x i8], [2 x i8]* %x, i64 0, i64 0
+  %call = call i64 @read(i32 0, i8* nonnull %0, i64 2)
+  %cmp.not = icmp eq i64 %call, 2
+  %1 = load %struct._IO_FILE*, %struct._IO_FILE** @stderr, align 8
+  br i1 %cmp.not, label %if.end, label %if.then
+
+if.then:
+  %2 = call i64 @fwrite(i8* getelementptr inbounds ([18 x i8], [18 x i8]* @.str, i64 0, i64 0), i64 17, i64 1, %struct._IO_FILE* %1)
+  br label %cleanup
+
+if.end:
+  ; A narrow index is sign-extended, multiplied by the element size (12), and
+  ; combined with the constant offset of the struct member (4 + 2 * 2). An
+  ; offset of -4 is only possible with the index -1.
+  %first = load i8, i8* %0, align 1
+  %elem = getelementptr [8 x %struct.entry], [8 x %struct.entry]* @table, i64 0, i8 %first, i32 1, i64 2
+  %elem.int = ptrtoint i16* %elem to i64
+  %offset = sub i64 %elem.int, ptrtoint ([8 x %struct.entry]* @table to i64)
+  %cmp = icmp eq i64 %offset, -4
+  %cond = select i1 %cmp, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.2, i64 0, i64 0), i8* getelementptr inbounds ([3 x i8], [3 x i8]* @.str.3, i64 0, i64 0)
+  ; SIMPLE: Trying to solve
+  ; SIMPLE: Found diverging input
+  ; SIMPLE: stdin0 -> #xff
+  ; ANY: no
+  %call1 = call i32 (%struct._IO_FILE*, i8*, ...) @fprintf(%struct._IO_FILE* %1, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.1, i64 0, i64 0), i8* %cond)
+
+  ; Byte-sized elements: the index is the offset.
+  %x.second = getelementptr inbounds [2 x i8], [2 x i8]* %x, i64 0, i64 1
+  %second.sym = load i8, i8* %x.second, align 1
+  %second.ext = zext i8 %second.sym to i64
+  %byte = getelementptr i8, i8* %0, i64 %second.ext
+  %byte.int = ptrtoint i8* %byte to i64
+  %base.int = ptrtoint i8* %0 to i64
+  %byte.offset = sub i64 %byte.int, %base.int
+  %cmp2 = icmp eq i64 %byte.offset, 7
+  %cond2 = select i1 %cmp2, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.2, i64 0, i64 0), i8* getelementptr inbounds ([3 x i8], [3 x i8]* @.str.3, i64 0, i64 0)
+  ; SIMPLE: Trying to solve
+  ; SIMPLE: Found diverging input
+  ; SIMPLE: stdin1 -> #x07
+  ; ANY: no
+  %call2 = call i32 (%struct._IO_FILE*, i8*, ...) @fprintf(%struct._IO_FILE* %1, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.1, i64 0, i64 0), i8* %cond2)
+  br label %cleanup
+
+cleanup:
+  %retval.0 = phi i32 [ -1, %if.then ], [ 0, %if.end ]
+  ret i32 %retval.0
+}
+
+declare i64 @read(i32, i8* nocapture, i64)
+declare i32 @fprintf(%struct._IO_FILE* nocapture, i8* nocapture readonly, ...)
+declare i64 @fwrite(i8* nocapture, i64, i64, %struct._IO_FILE* nocapture)
@@ -0,0 +1,96 @@
+; This file is part of SymCC.
+;
+; SymCC is free software: you can redistribute it and/or modify it under the
+; terms of the GNU General Public License as published by the Free Software
+; Foundation, either version 3 of the License, or (at your option) any later
+; version.
+;
+; SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+; WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+; A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+;
+; You should have received a copy of the GNU General Public License along with
+; SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+
+; Check that functions on the deny list are compiled without tracking: their
+; return values are concrete, and their writes to memory make the memory
+; concrete, even if it held symbolic data before. The rest of the program is
+; instrumented as usual.
+;
+; Since the bitcode is written by hand, we first run llc on it because it
+; performs a validity check, whereas Clang doesn't.
+;
+; RUN: llc %s -o /dev/null
+; RUN: echo "fun:scramble" > %t.list
+; RUN: env SYMCC_INSTRUMENT_DENYLIST=%t.list %symcc -O0 %s -o %t
+; RUN: echo -ne "\x00" | %t 2>&1 | %filecheck %s
+
+%struct._IO_FILE = type opaque
+
+@stderr = external dso_local local_unnamed_addr global %struct._IO_FILE*, align 8
+@g = dso_local global i8 0, align 1
+@.str = private unnamed_addr constant [18 x i8] c"Failed to read x\0A\00", align 1
+@.str.1 = private unnamed_addr constant [4 x i8] c"%s\0A\00", align 1
+@.str.2 = private unnamed_addr constant [4 x i8] c"yes\00", align 1
+@.str.3 = private unnamed_addr constant [3 x i8] c"no\00", align 1
+
+define dso_local i8 @scramble(i8 %value) noinline {
+entry:
+  %plus = add i8 %value, 1
+  store i8 %plus, i8* @g, align 1
+  %times = mul i8 %value, 3
+  ret i8 %times
+}
+
+define dso_local i32 @main(i32 %argc, i8** nocapture readnone %argv) local_unnamed_addr {
+entry:
+  %x = alloca i8, align 1
+  %call = call i64 @read(i32 0, i8* nonnull %x, i64 1)
+  %cmp.not = icmp eq i64 %call, 1
+  %0 = load %struct._IO_FILE*, %struct._IO_FILE** @stderr, align 8
+  br i1 %cmp.not, label %if.end, label %if.then
+
+if.then:
+  %1 = call i64 @fwrite(i8* getelementptr inbounds ([18 x i8], [18 x i8]* @.str, i64 0, i64 0), i64 17, i64 1, %struct._IO_FILE* %0)
+  br label %cleanup
+
+if.end:
+  ; Give the global a symbolic value, which the denied function overwrites.
+  %v = load i8, i8* %x, align 1
+  store i8 %v, i8* @g, align 1
+  %r = call i8 @scramble(i8 %v)
+
+  ; The return value is concrete.
+  %cmp = icmp eq i8 %r, 42
+  %cond = select i1 %cmp, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.2, i64 0, i64 0), i8* getelementptr inbounds ([3 x i8], [3 x i8]* @.str.3, i64 0, i64 0)
+  ; SIMPLE-NOT: Trying to solve
+  ; ANY: no
+  %call1 = call i32 (%struct._IO_FILE*, i8*, ...) @fprintf(%struct._IO_FILE* %0, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.1, i64 0, i64 0), i8* %cond)
+
+  ; So is the global.
+  %w = load i8, i8* @g, align 1
+  %cmp2 = icmp eq i8 %w, 7
+  %cond2 = select i1 %cmp2, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.2, i64 0, i64 0), i8* getelementptr inbounds ([3 x i8], [3 x i8]* @.str.3, i64 0, i64 0)
+  ; SIMPLE-NOT: Trying to solve
+  ; ANY: no
+  %call2 = call i32 (%struct._IO_FILE*, i8*, ...) @fprintf(%struct._IO_FILE* %0, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.1, i64 0, i64 0), i8* %cond2)
+
+  ; The input itself is still symbolic in main.
+  %cmp3 = icmp eq i8 %v, 9
+  %cond3 = select i1 %cmp3, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.2, i64 0, i64 0), i8* getelementptr inbounds ([3 x i8], [3 x i8]* @.str.3, i64 0, i64 0)
+  ; SIMPLE: Trying to solve
+  ; SIMPLE: Found diverging input
+  ; SIMPLE: stdin0 -> #x09
+  ; ANY: no
+  %call3 = call i32 (%struct._IO_FILE*, i8*, ...) @fprintf(%struct._IO_FILE* %0, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.1, i64 0, i64 0), i8* %cond3)
+  br label %cleanup
+
+cleanup:
+  %retval.0 = phi i32 [ -1, %if.then ], [ 0, %if.end ]
+  ret i32 %retval.0
+}
+
+declare i64 @read(i32, i8* nocapture, i64)
+declare i32 @fprintf(%struct._IO_FILE* nocapture, i8* nocapture readonly, ...)
+declare i64 @fwrite(i8* nocapture, i64, i64, %struct._IO_FILE* nocapture)
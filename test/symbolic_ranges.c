@@ -0,0 +1,48 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// RUN: %symcc -O2 %s -o %t
+// RUN: echo -n bb | env SYMCC_SYMBOLIC_RANGES=1 %t 2>&1 | %filecheck %s
+//
+// Check that only the configured input bytes are symbolic.
+
+#include <stdio.h>
+#include <unistd.h>
+
+int main(int argc, char* argv[]) {
+  char buf[2];
+
+  ssize_t nbytes = read(STDIN_FILENO, buf, sizeof(buf));
+  if (nbytes != 2)
+    return 1;
+
+  // The first byte is outside the symbolic range, so it's concrete.
+  // SIMPLE-NOT: Trying to solve
+  // QSYM-NOT: SMT
+  if (buf[0] == 'a')
+    fprintf(stderr, "First\n");
+  fprintf(stderr, "Checked the first byte\n");
+  // ANY: Checked the first byte
+
+  // SIMPLE: Trying to solve
+  // SIMPLE: Found diverging input
+  // SIMPLE: stdin1 -> #x61
+  // QSYM-COUNT-2: SMT
+  // QSYM: New testcase
+  if (buf[1] == 'a')
+    fprintf(stderr, "Second\n");
+  fprintf(stderr, "Done\n");
+  // ANY: Done
+  return 0;
+}
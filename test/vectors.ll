@@ -0,0 +1,85 @@
+; This file is part of SymCC.
+;
+; SymCC is free software: you can redistribute it and/or modify it under the
+; terms of the GNU General Public License as published by the Free Software
+; Foundation, either version 3 of the License, or (at your option) any later
+; version.
+;
+; SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+; WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+; A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+;
+; You should have received a copy of the GNU General Public License along with
+; SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+; Check that vector instructions propagate symbolic expressions lane by lane.
+; We don't optimize, so that the vector instructions aren't turned into scalar
+; ones before instrumentation.
+;
+; Since the bitcode is written by hand, we first run llc on it because it
+; performs a validity check, whereas Clang doesn't.
+;
+; RUN: llc %s -o /dev/null
+; RUN: %symcc -O0 %s -o %t
+; RUN: echo -ne "\x00\x00\x00\x00" | %t 2>&1 | %filecheck %s
+
+%struct._IO_FILE = type opaque
+
+@stderr = external dso_local local_unnamed_addr global %struct._IO_FILE*, align 8
+@.str = private unnamed_addr constant [18 x i8] c"Failed to read x\0A\00", align 1
+@.str.1 = private unnamed_addr constant [4 x i8] c"%s\0A\00", align 1
+@.str.2 = private unnamed_addr constant [4 x i8] c"yes\00", align 1
+@.str.3 = private unnamed_addr constant [3 x i8] c"no\00", align 1
+
+define dso_local i32 @main(i32 %argc, i8** nocapture readnone %argv) local_unnamed_addr {
+entry:
+  %x = alloca <4 x i8>, align 4
+  %0 = bitcast <4 x i8>* %x to i8*
+  %call = call i64 @read(i32 0, i8* nonnull %0, i64 4)
+  %cmp.not = icmp eq i64 %call, 4
+  %1 = load %struct._IO_FILE*, %struct._IO_FILE** @stderr, align 8
+  br i1 %cmp.not, label %if.end, label %if.then
+
+if.then:
+  %2 = call i64 @fwrite(i8* getelementptr inbounds ([18 x i8], [18 x i8]* @.str, i64 0, i64 0), i64 17, i64 1, %struct._IO_FILE* %1)
+  br label %cleanup
+
+if.end:
+  ; Lane-wise arithmetic, shuffling and lane extraction: the first lane of the
+  ; reversed vector is x[3] + 4.
+  %v = load <4 x i8>, <4 x i8>* %x, align 4
+  %sum = add <4 x i8> %v, <i8 1, i8 2, i8 3, i8 4>
+  %rev = shufflevector <4 x i8> %sum, <4 x i8> undef, <4 x i32> <i32 3, i32 2, i32 1, i32 0>
+  %first = extractelement <4 x i8> %rev, i32 0
+  %cmp = icmp eq i8 %first, 69
+  %cond = select i1 %cmp, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.2, i64 0, i64 0), i8* getelementptr inbounds ([3 x i8], [3 x i8]* @.str.3, i64 0, i64 0)
+  ; SIMPLE: Trying to solve
+  ; SIMPLE: Found diverging input
+  ; SIMPLE: stdin3 -> #x41
+  ; ANY: no
+  %call1 = call i32 (%struct._IO_FILE*, i8*, ...) @fprintf(%struct._IO_FILE* %1, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.1, i64 0, i64 0), i8* %cond)
+
+  ; Vector comparison, and inserting a lane: all lanes must be greater than
+  ; 0x30, except for the second one, which we override.
+  %with = insertelement <4 x i8> %v, i8 100, i32 1
+  %gt = icmp ugt <4 x i8> %with, <i8 48, i8 48, i8 48, i8 48>
+  %mask = bitcast <4 x i1> %gt to i4
+  %all = icmp eq i4 %mask, -1
+  %cond2 = select i1 %all, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.2, i64 0, i64 0), i8* getelementptr inbounds ([3 x i8], [3 x i8]* @.str.3, i64 0, i64 0)
+  ; SIMPLE: Trying to solve
+  ; SIMPLE: Found diverging input
+  ; SIMPLE-DAG: stdin0 -> #x{{(3[1-9a-f]|[4-9a-f][0-9a-f])}}
+  ; SIMPLE-DAG: stdin2 -> #x{{(3[1-9a-f]|[4-9a-f][0-9a-f])}}
+  ; SIMPLE-DAG: stdin3 -> #x{{(3[1-9a-f]|[4-9a-f][0-9a-f])}}
+  ; ANY: no
+  %call2 = call i32 (%struct._IO_FILE*, i8*, ...) @fprintf(%struct._IO_FILE* %1, i8* getelementptr inbounds ([4 x i8], [4 x i8]* @.str.1, i64 0, i64 0), i8* %cond2)
+  br label %cleanup
+
+cleanup:
+  %retval.0 = phi i32 [ -1, %if.then ], [ 0, %if.end ]
+  ret i32 %retval.0
+}
+
+declare i64 @read(i32, i8* nocapture, i64)
+declare i32 @fprintf(%struct._IO_FILE* nocapture, i8* nocapture readonly, ...)
+declare i64 @fwrite(i8* nocapture, i64, i64, %struct._IO_FILE* nocapture)